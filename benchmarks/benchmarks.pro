@@ -0,0 +1,14 @@
+TEMPLATE = subdirs
+
+SUBDIRS = \
+        broadcast \
+        connectionstorm \
+        fakeplugin \
+        settingsparse \
+        subscriptions \
+        unlocklatency
+
+connectionstorm.depends = \
+        fakeplugin
+unlocklatency.depends = \
+        fakeplugin
@@ -0,0 +1,7 @@
+TEMPLATE = app
+TARGET = devicelock-broadcast-benchmark
+
+include(../common/common.pri)
+
+SOURCES = \
+        main.cpp
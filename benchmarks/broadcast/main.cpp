@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+// Measures the cost on the daemon's event loop of broadcasting a signal to many connections.
+//
+// The benchmark hosts two objects on a private socket, one which every connection is registered
+// on and one which only one connection in a hundred is registered on, and for each client count
+// starts a child process which opens that many peer connections and reads everything sent to
+// them.  It then broadcasts a signal from each object repeatedly and reports the time each
+// broadcast took and that time divided by the number of recipients.  The cost of broadcasting
+// from the sparse object should follow its own membership rather than the number of
+// connections to the daemon.
+//
+// The signal is broadcast three ways on the object every connection is registered on:
+//
+//  signal          a signal marshalled once and written to every recipient from the writer thread.
+//  property        an uncoalesced property change, which takes the same path with a map argument.
+//  per recipient   the signal built and sent through QDBusConnection for each recipient, which
+//                  was how every signal was sent before broadcasts were marshalled once.
+
+#include "benchmark.h"
+#include "peerclients.h"
+
+#include <hostobject.h>
+#include <hostservice.h>
+
+#include <QCommandLineParser>
+#include <QProcess>
+
+using namespace NemoDeviceLock;
+
+static const auto benchmarkInterface = QStringLiteral("org.nemomobile.devicelock.Benchmark");
+
+class BroadcastObject : public HostObject
+{
+public:
+    BroadcastObject(const QString &path, int interval)
+        : HostObject(path)
+        , m_interval(interval)
+    {
+    }
+
+    bool authorizeConnection(const QDBusConnection &) override
+    {
+        return m_authorizations++ % m_interval == 0;
+    }
+
+    void clientConnected(const QString &connectionName) override
+    {
+        HostObject::clientConnected(connectionName);
+
+        m_connections.insert(connectionName);
+    }
+
+    // This is called for every connection, whether it was registered on the object or not.
+    void clientDisconnected(const QString &connectionName) override
+    {
+        HostObject::clientDisconnected(connectionName);
+
+        m_connections.remove(connectionName);
+    }
+
+    int connected() const { return m_connections.count(); }
+
+    // These return the time taken in nanoseconds.
+    qint64 broadcast(int value)
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        broadcastSignal(benchmarkInterface, QStringLiteral("Changed"), QVariantList { value });
+
+        return timer.nsecsElapsed();
+    }
+
+    qint64 changeProperty(int value)
+    {
+        setPropertyChangesCoalesced(false);
+
+        QElapsedTimer timer;
+        timer.start();
+
+        propertyChanged(benchmarkInterface, QStringLiteral("Value"), value);
+
+        return timer.nsecsElapsed();
+    }
+
+    qint64 sendToEach(int value)
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        for (const QString &connectionName : m_connections) {
+            QDBusMessage message = QDBusMessage::createSignal(path(), benchmarkInterface, QStringLiteral("Changed"));
+            message.setArguments(QVariantList { value });
+            QDBusConnection(connectionName).send(message);
+        }
+
+        return timer.nsecsElapsed();
+    }
+
+private:
+    QSet<QString> m_connections;
+    const int m_interval;
+    int m_authorizations = 0;
+};
+
+struct Fanout
+{
+    void record(qint64 elapsed, int recipients)
+    {
+        broadcast.record(elapsed / 1000);
+        if (recipients > 0) {
+            recipient.record(elapsed / recipients);
+        }
+    }
+
+    Benchmark::Samples broadcast;
+    Benchmark::Samples recipient;
+};
+
+static bool runBroadcasts(
+        const QString &address,
+        int count,
+        int iterations,
+        BroadcastObject *dense,
+        BroadcastObject *sparse)
+{
+    QProcess clients;
+    clients.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    clients.start(QCoreApplication::applicationFilePath(), {
+        QStringLiteral("--clients"), QString::number(count),
+        QStringLiteral("--address"), address
+    });
+
+    if (!Benchmark::waitUntil([&]() { return dense->connected() >= count; }, 60000)) {
+        std::fprintf(stderr, "Only %i of %i connections were registered\n", dense->connected(), count);
+        clients.kill();
+        clients.waitForFinished();
+        return false;
+    }
+
+    const int sparseCount = sparse->connected();
+
+    Fanout denseFanout;
+    Fanout sparseFanout;
+    Fanout propertyFanout;
+    Fanout unencodedFanout;
+
+    for (int i = 0; i < iterations; ++i) {
+        denseFanout.record(dense->broadcast(i), dense->connected());
+        sparseFanout.record(sparse->broadcast(i), sparseCount);
+        propertyFanout.record(dense->changeProperty(i), dense->connected());
+        unencodedFanout.record(dense->sendToEach(i), dense->connected());
+
+        // Let the writer thread and the clients keep up.
+        QCoreApplication::processEvents();
+    }
+
+    clients.closeWriteChannel();
+    Benchmark::waitUntil([&]() { return dense->connected() == 0; }, 60000);
+    clients.waitForFinished();
+
+    char title[64];
+    std::snprintf(title, sizeof(title), "%i clients, %i sparse", count, sparseCount);
+
+    Benchmark::printHeader(title);
+    Benchmark::print("signal", denseFanout.broadcast);
+    Benchmark::print("property", propertyFanout.broadcast);
+    Benchmark::print("per recipient", unencodedFanout.broadcast);
+    Benchmark::print("sparse signal", sparseFanout.broadcast);
+
+    Benchmark::printHeader("Cost per recipient", "ns");
+    Benchmark::print("signal", denseFanout.recipient);
+    Benchmark::print("property", propertyFanout.recipient);
+    Benchmark::print("per recipient", unencodedFanout.recipient);
+    Benchmark::print("sparse signal", sparseFanout.recipient);
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Device lock signal broadcast benchmark"));
+    parser.addHelpOption();
+
+    const QCommandLineOption countsOption(
+                QStringLiteral("counts"),
+                QStringLiteral("A comma separated list of the numbers of concurrent clients."),
+                QStringLiteral("counts"),
+                QStringLiteral("10,100,1000"));
+    const QCommandLineOption iterationsOption(
+                QStringLiteral("iterations"),
+                QStringLiteral("The number of signals broadcast from each object."),
+                QStringLiteral("count"),
+                QStringLiteral("1000"));
+    // Used internally to start the client process.
+    const QCommandLineOption clientsOption(QStringLiteral("clients"), QString(), QStringLiteral("count"));
+    const QCommandLineOption addressOption(QStringLiteral("address"), QString(), QStringLiteral("address"));
+    clientsOption.setHidden(true);
+    addressOption.setHidden(true);
+
+    parser.addOption(countsOption);
+    parser.addOption(iterationsOption);
+    parser.addOption(clientsOption);
+    parser.addOption(addressOption);
+    parser.process(application);
+
+    Benchmark::raiseFileLimit();
+
+    if (parser.isSet(clientsOption)) {
+        return Benchmark::runPeerClients(parser.value(addressOption), parser.value(clientsOption).toInt());
+    }
+
+    QTemporaryDir directory;
+    const QString address = Benchmark::useHostDirectory(directory, QVariantMap());
+
+    BroadcastObject dense(QStringLiteral("/devicelock/benchmark/dense"), 1);
+    BroadcastObject sparse(QStringLiteral("/devicelock/benchmark/sparse"), 100);
+
+    HostService service({ &dense, &sparse });
+
+    const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+
+    for (const QString &count : parser.value(countsOption).split(QLatin1Char(','))) {
+        if (!runBroadcasts(address, qMax(1, count.toInt()), iterations, &dense, &sparse)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef NEMODEVICELOCK_BENCHMARK_H
+#define NEMODEVICELOCK_BENCHMARK_H
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSettings>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <QVariantMap>
+#include <QVector>
+
+#include <algorithm>
+#include <cstdio>
+
+namespace NemoDeviceLock
+{
+
+namespace Benchmark
+{
+
+// A monotonic timestamp in microseconds shared by everything in the process, so times taken in
+// the host and the client can be compared.
+inline qint64 now()
+{
+    static QElapsedTimer clock;
+    if (!clock.isValid()) {
+        clock.start();
+    }
+    return clock.nsecsElapsed() / 1000;
+}
+
+// Retains every sample so exact percentiles can be reported, unlike the approximate
+// LatencyHistogram the daemon keeps.
+class Samples
+{
+public:
+    void record(qint64 value) { m_values.append(value); m_sorted = false; }
+
+    int count() const { return m_values.count(); }
+
+    qint64 percentile(int percent)
+    {
+        if (m_values.isEmpty()) {
+            return 0;
+        } else if (!m_sorted) {
+            std::sort(m_values.begin(), m_values.end());
+            m_sorted = true;
+        }
+
+        // Nearest rank.
+        const int rank = (m_values.count() * percent + 99) / 100;
+        return m_values.at(qBound(0, rank - 1, m_values.count() - 1));
+    }
+
+    qint64 total() const
+    {
+        qint64 total = 0;
+        for (const qint64 value : m_values) {
+            total += value;
+        }
+        return total;
+    }
+
+private:
+    QVector<qint64> m_values;
+    bool m_sorted = false;
+};
+
+inline void printHeader(const char *title, const char *unit = "us")
+{
+    std::printf("\n%s\n%-32s %8s %10s %10s %10s\n", title, "", "count", "p50", "p95", "p99");
+    std::printf("%-32s %8s %10s %10s %10s\n", "", "", unit, unit, unit);
+}
+
+inline void print(const char *name, Samples &samples)
+{
+    std::printf("%-32s %8d %10lld %10lld %10lld\n",
+                name,
+                samples.count(),
+                samples.percentile(50),
+                samples.percentile(95),
+                samples.percentile(99));
+}
+
+// Points the host objects at a configuration file and socket in the directory, so a benchmark can
+// run alongside the system daemon.  The configuration values are keyed by group/key and this must
+// be called before any host object is constructed.
+inline QString useHostDirectory(const QTemporaryDir &directory, const QVariantMap &configuration)
+{
+    const QString configurationPath = directory.filePath(QStringLiteral("devicelock.conf"));
+    {
+        QSettings settings(configurationPath, QSettings::IniFormat);
+        for (auto it = configuration.begin(); it != configuration.end(); ++it) {
+            settings.setValue(it.key(), it.value());
+        }
+    }
+
+    const QString address = QStringLiteral("unix:path=") + directory.filePath(QStringLiteral("socket"));
+
+    qputenv("NEMODEVICELOCK_CONFIG", QFile::encodeName(configurationPath));
+    qputenv("NEMODEVICELOCK_ADDRESS", address.toUtf8());
+
+    return address;
+}
+
+// Processes events until the predicate holds, checking it again each time the object emits the
+// signal.
+template <typename Object, typename Signal, typename Predicate>
+bool waitUntil(Object *object, Signal signal, const Predicate &predicate, int timeout = 10000)
+{
+    QSignalSpy spy(object, signal);
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    while (!predicate()) {
+        const int remaining = timeout - int(elapsed.elapsed());
+        if (remaining <= 0 || !spy.wait(remaining)) {
+            return predicate();
+        }
+    }
+    return true;
+}
+
+// Processes events until the predicate holds, for state which changes without a signal.
+template <typename Predicate>
+bool waitUntil(const Predicate &predicate, int timeout = 10000)
+{
+    QTimer poll;
+    poll.start(1);
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    while (!predicate()) {
+        if (elapsed.elapsed() >= timeout) {
+            return predicate();
+        }
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+    return true;
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,38 @@
+QT -= gui
+QT += dbus testlib
+
+CONFIG += \
+        c++11 \
+        link_pkgconfig
+
+PKGCONFIG += \
+        dbus-1 \
+        keepalive \
+        nemodbus \
+        libsystemd
+
+INCLUDEPATH += \
+        $$PWD \
+        $$PWD/../../src \
+        $$PWD/../../src/nemo-devicelock \
+        $$PWD/../../src/nemo-devicelock/host \
+        $$PWD/../../src/nemo-devicelock/host/cli \
+        $$PWD/../../src/nemo-devicelock/private
+
+PRE_TARGETDEPS += \
+        $$OUT_PWD/../../src/nemo-devicelock/host/libnemodevicelock-host.a
+
+LIBS += \
+        -L$$OUT_PWD/../../src/nemo-devicelock/host -lnemodevicelock-host \
+        -L$$OUT_PWD/../../src/nemo-devicelock -lnemodevicelock
+
+# Run against the libraries in the build tree.
+QMAKE_RPATHDIR += \
+        $$OUT_PWD/../../src/nemo-devicelock
+
+HEADERS += \
+        $$PWD/benchmark.h \
+        $$PWD/peerclients.h
+
+# Keep the benchmarks and the fake plugin they run together.
+DESTDIR = $$OUT_PWD/..
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef NEMODEVICELOCK_PEERCLIENTS_H
+#define NEMODEVICELOCK_PEERCLIENTS_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include <dbus/dbus.h>
+
+#include <poll.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace NemoDeviceLock
+{
+
+namespace Benchmark
+{
+
+// Both ends of every connection are file descriptors, lift the soft limit as far as allowed.
+inline void raiseFileLimit()
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+// The body of a child process which opens a number of peer connections to the daemon and holds
+// them until its standard input is closed.  The connections are opened with libdbus directly so
+// they cost no more than a socket each, and anything sent to them is read and discarded so the
+// daemon never sees them stall.  The process exits without closing the connections so the kernel
+// closes them all at once.
+inline int runPeerClients(const QString &address, int count)
+{
+    const QByteArray encodedAddress = address.toUtf8();
+
+    QVector<DBusConnection *> connections;
+    connections.reserve(count);
+
+    for (int i = 0; i < count; ++i) {
+        DBusError error;
+        dbus_error_init(&error);
+
+        DBusConnection * const connection = dbus_connection_open_private(encodedAddress.constData(), &error);
+        if (!connection) {
+            std::fprintf(stderr, "Failed to open connection %i: %s\n", i, error.message);
+            dbus_error_free(&error);
+            return EXIT_FAILURE;
+        }
+        dbus_connection_set_exit_on_disconnect(connection, FALSE);
+        connections.append(connection);
+    }
+
+    // The first poll entry is standard input, the rest are the connections.
+    QVector<struct pollfd> descriptors(count + 1);
+    descriptors[0].fd = STDIN_FILENO;
+    descriptors[0].events = POLLIN;
+    for (int i = 0; i < count; ++i) {
+        int fd = -1;
+        dbus_connection_get_socket(connections.at(i), &fd);
+        descriptors[i + 1].fd = fd;
+        descriptors[i + 1].events = POLLIN;
+    }
+
+    // Authentication needs the client to write as well as read, so every connection is pumped
+    // until they've all authenticated before waiting for anything to read.
+    for (int authenticated = 0; authenticated < count;) {
+        authenticated = 0;
+        for (DBusConnection * const connection : connections) {
+            if (dbus_connection_get_is_authenticated(connection)) {
+                ++authenticated;
+            } else if (!dbus_connection_read_write(connection, 0)) {
+                std::fprintf(stderr, "A connection was closed while authenticating\n");
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    for (;;) {
+        if (::poll(descriptors.data(), descriptors.count(), -1) < 0) {
+            continue;
+        } else if (descriptors.at(0).revents) {
+            char byte;
+            if (::read(STDIN_FILENO, &byte, 1) <= 0) {
+                _exit(EXIT_SUCCESS);
+            }
+        }
+
+        for (int i = 0; i < count; ++i) {
+            if (descriptors.at(i + 1).revents & (POLLERR | POLLHUP)) {
+                descriptors[i + 1].fd = -1;
+            } else if (descriptors.at(i + 1).revents) {
+                DBusConnection * const connection = connections.at(i);
+
+                dbus_connection_read_write(connection, 0);
+                while (DBusMessage * const message = dbus_connection_pop_message(connection)) {
+                    dbus_message_unref(message);
+                }
+            }
+        }
+    }
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+// Measures how the daemon copes with many clients connecting and disconnecting at once, as
+// happens at boot and when the home screen restarts.
+//
+// The benchmark hosts the same objects as the daemon on a private socket and for each client
+// count starts a child process which opens that many peer connections concurrently and holds
+// them until told to exit, at which point they're all closed together.  It reports:
+//
+//  registration    the time from a connection being accepted to it being registered with every
+//                  object.
+//  stall           how late a 1ms timer on the daemon's event loop fired while the connections
+//                  were being registered or released.
+//  memory          the increase in the daemon's resident memory per connection.
+
+#include "benchmark.h"
+#include "peerclients.h"
+
+#include <cliauthenticator.h>
+#include <clidevicelock.h>
+#include <clidevicelocksettings.h>
+#include <clidevicereset.h>
+#include <cliencryptionsettings.h>
+#include <hostfingerprintsensor.h>
+#include <hostfingerprintsettings.h>
+#include <hostservice.h>
+
+#include <QCommandLineParser>
+#include <QProcess>
+
+#include <unistd.h>
+
+using namespace NemoDeviceLock;
+using Benchmark::now;
+
+// Registered last, so a connection has been registered with or released by every other object by
+// the time this sees it.
+class ProbeObject : public HostObject
+{
+public:
+    ProbeObject()
+        : HostObject(QStringLiteral("/devicelock/benchmark"))
+    {
+    }
+
+    void clientConnected(const QString &connectionName) override
+    {
+        HostObject::clientConnected(connectionName);
+
+        registered.insert(connectionName, now());
+    }
+
+    void clientDisconnected(const QString &connectionName) override
+    {
+        HostObject::clientDisconnected(connectionName);
+
+        ++disconnected;
+        lastDisconnected = now();
+    }
+
+    QHash<QString, qint64> registered;
+    int disconnected = 0;
+    qint64 lastDisconnected = 0;
+};
+
+// Records how late a timer on the event loop fires, which is how long anything else waiting on
+// the event loop would have been delayed.
+class StallMonitor : public QObject
+{
+public:
+    StallMonitor()
+    {
+        m_timer.setTimerType(Qt::PreciseTimer);
+        m_timer.setInterval(interval);
+        connect(&m_timer, &QTimer::timeout, this, &StallMonitor::tick);
+    }
+
+    void start()
+    {
+        samples = Benchmark::Samples();
+        m_last = now();
+        m_timer.start();
+    }
+
+    void stop()
+    {
+        m_timer.stop();
+    }
+
+    Benchmark::Samples samples;
+
+private:
+    enum { interval = 1 };
+
+    void tick()
+    {
+        const qint64 timestamp = now();
+        samples.record(qMax<qint64>(0, timestamp - m_last - interval * 1000));
+        m_last = timestamp;
+    }
+
+    QTimer m_timer;
+    qint64 m_last = 0;
+};
+
+static qint64 residentMemory()
+{
+    QFile statm(QStringLiteral("/proc/self/statm"));
+    if (!statm.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    return statm.readAll().split(' ').value(1).toLongLong() * sysconf(_SC_PAGESIZE);
+}
+
+static bool runStorm(
+        const QString &address,
+        int count,
+        HostService *service,
+        ProbeObject *probe,
+        StallMonitor *stall)
+{
+    QHash<QString, qint64> accepted;
+    const auto connection = QObject::connect(
+                service, &QDBusServer::newConnection, [&](const QDBusConnection &connection) {
+        accepted.insert(connection.name(), now());
+    });
+
+    probe->registered.clear();
+    probe->disconnected = 0;
+
+    const qint64 memoryBefore = residentMemory();
+
+    QProcess clients;
+    clients.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    clients.start(QCoreApplication::applicationFilePath(), {
+        QStringLiteral("--clients"), QString::number(count),
+        QStringLiteral("--address"), address
+    });
+
+    stall->start();
+
+    const bool registered = Benchmark::waitUntil([&]() {
+        return probe->registered.count() >= count;
+    }, 60000);
+
+    stall->stop();
+    Benchmark::Samples connectStall = stall->samples;
+
+    QObject::disconnect(connection);
+
+    if (!registered) {
+        std::fprintf(stderr, "Only %i of %i connections were registered\n", probe->registered.count(), count);
+        clients.kill();
+        clients.waitForFinished();
+        return false;
+    }
+
+    const qint64 memoryRegistered = residentMemory();
+
+    Benchmark::Samples registration;
+    for (auto it = probe->registered.cbegin(); it != probe->registered.cend(); ++it) {
+        if (accepted.contains(it.key())) {
+            registration.record(it.value() - accepted.value(it.key()));
+        }
+    }
+
+    stall->start();
+
+    const qint64 disconnecting = now();
+    clients.closeWriteChannel();
+
+    const bool released = Benchmark::waitUntil([&]() {
+        return probe->disconnected >= count;
+    }, 60000);
+
+    stall->stop();
+    Benchmark::Samples disconnectStall = stall->samples;
+
+    clients.waitForFinished();
+
+    if (!released) {
+        std::fprintf(stderr, "Only %i of %i connections were released\n", probe->disconnected, count);
+        return false;
+    }
+
+    char title[64];
+    std::snprintf(title, sizeof(title), "%i clients", count);
+
+    Benchmark::printHeader(title);
+    Benchmark::print("registration", registration);
+    Benchmark::print("connect stall", connectStall);
+    Benchmark::print("disconnect stall", disconnectStall);
+
+    std::printf("%-32s %8lld bytes per connection\n",
+                "memory", (memoryRegistered - memoryBefore) / count);
+    std::printf("%-32s %8lld us to release every connection\n",
+                "disconnect storm", probe->lastDisconnected - disconnecting);
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Device lock connection storm benchmark"));
+    parser.addHelpOption();
+
+    const QCommandLineOption countsOption(
+                QStringLiteral("counts"),
+                QStringLiteral("A comma separated list of the numbers of concurrent clients."),
+                QStringLiteral("counts"),
+                QStringLiteral("10,100,1000"));
+    const QCommandLineOption pluginOption(
+                QStringLiteral("plugin"),
+                QStringLiteral("The fake plugin executable."),
+                QStringLiteral("path"),
+                QCoreApplication::applicationDirPath() + QStringLiteral("/devicelock-fake-plugin"));
+    // Used internally to start the client process.
+    const QCommandLineOption clientsOption(QStringLiteral("clients"), QString(), QStringLiteral("count"));
+    const QCommandLineOption addressOption(QStringLiteral("address"), QString(), QStringLiteral("address"));
+    clientsOption.setHidden(true);
+    addressOption.setHidden(true);
+
+    parser.addOption(countsOption);
+    parser.addOption(pluginOption);
+    parser.addOption(clientsOption);
+    parser.addOption(addressOption);
+    parser.process(application);
+
+    Benchmark::raiseFileLimit();
+
+    if (parser.isSet(clientsOption)) {
+        return Benchmark::runPeerClients(parser.value(addressOption), parser.value(clientsOption).toInt());
+    }
+
+    QTemporaryDir directory;
+    const QString address = Benchmark::useHostDirectory(directory, {
+        { QStringLiteral("DeviceLock/pluginName"), parser.value(pluginOption) }
+    });
+
+    CliAuthenticator authenticator;
+    CliDeviceLock deviceLock;
+    CliDeviceLockSettings deviceLockSettings;
+    CliDeviceReset deviceReset;
+    CliEncryptionSettings encryptionSettings;
+    HostFingerprintSensor fingerprintSensor;
+    HostFingerprintSettings fingerprintSettings;
+    ProbeObject probe;
+
+    HostService service({
+        &authenticator,
+        &deviceLock,
+        &deviceLockSettings,
+        &deviceReset,
+        &encryptionSettings,
+        &fingerprintSensor,
+        &fingerprintSettings,
+        &probe
+    });
+
+    StallMonitor stall;
+
+    for (const QString &count : parser.value(countsOption).split(QLatin1Char(','))) {
+        if (!runStorm(address, qMax(1, count.toInt()), &service, &probe, &stall)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,12 @@
+TEMPLATE = app
+TARGET = devicelock-fake-plugin
+
+QT -= gui
+
+CONFIG += \
+        c++11
+
+SOURCES = \
+        main.cpp
+
+DESTDIR = $$OUT_PWD/..
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+// A stand in for a device lock plugin which accepts a single fixed security code, for
+// benchmarking the daemon without a real plugin.
+//
+// NEMODEVICELOCK_FAKE_PLUGIN_CODE is the accepted code, 12345 by default.
+// NEMODEVICELOCK_FAKE_PLUGIN_DELAY is the time in milliseconds checking a code takes, 0 by
+// default.
+//
+// Given the --persistent argument requests are read from standard input using the protocol
+// described in pluginprocess.h.  Only the verbs the benchmarks exercise are implemented, the rest
+// fail.
+
+#include <QByteArray>
+#include <QStringList>
+#include <QThread>
+
+#include <unistd.h>
+
+static const int success = 0;
+static const int failure = 1;
+
+static int invoke(const QStringList &arguments)
+{
+    static const QString code = qEnvironmentVariableIsEmpty("NEMODEVICELOCK_FAKE_PLUGIN_CODE")
+            ? QStringLiteral("12345")
+            : QString::fromUtf8(qgetenv("NEMODEVICELOCK_FAKE_PLUGIN_CODE"));
+    static const int delay = qEnvironmentVariableIntValue("NEMODEVICELOCK_FAKE_PLUGIN_DELAY");
+
+    const QString verb = arguments.value(0);
+
+    if (verb == QLatin1String("--is-set")) {
+        return success;
+    } else if (verb == QLatin1String("--check-code") || verb == QLatin1String("--unlock")) {
+        if (delay > 0) {
+            QThread::msleep(delay);
+        }
+        return arguments.value(1) == code ? success : failure;
+    } else {
+        return failure;
+    }
+}
+
+static bool readFully(void *data, size_t size)
+{
+    char *bytes = static_cast<char *>(data);
+    while (size > 0) {
+        const ssize_t count = ::read(STDIN_FILENO, bytes, size);
+        if (count <= 0) {
+            return false;
+        }
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+static bool writeFully(const void *data, size_t size)
+{
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0) {
+        const ssize_t count = ::write(STDOUT_FILENO, bytes, size);
+        if (count <= 0) {
+            return false;
+        }
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+static int runPersistent()
+{
+    for (;;) {
+        quint32 count = 0;
+        if (!readFully(&count, sizeof(count))) {
+            // The daemon closed the channel, exit.
+            return success;
+        }
+
+        QStringList arguments;
+        for (quint32 i = 0; i < count; ++i) {
+            quint32 length = 0;
+            if (!readFully(&length, sizeof(length))) {
+                return failure;
+            }
+
+            QByteArray argument(int(length), Qt::Uninitialized);
+            if (!readFully(argument.data(), length)) {
+                return failure;
+            }
+            arguments.append(QString::fromUtf8(argument));
+        }
+
+        const qint32 exitCode = invoke(arguments);
+        if (!writeFully(&exitCode, sizeof(exitCode))) {
+            return failure;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QStringList arguments;
+    for (int i = 1; i < argc; ++i) {
+        arguments.append(QString::fromLocal8Bit(argv[i]));
+    }
+
+    return arguments.value(0) == QLatin1String("--persistent")
+            ? runPersistent()
+            : invoke(arguments);
+}
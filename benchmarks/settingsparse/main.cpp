@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+// Compares the cost of parsing the device lock settings file with the single pass parser and
+// with GKeyFile, which every reload used before and which the single pass parser falls back to.
+//
+// Each parser is run repeatedly over the same file contents and the benchmark reports the time
+// each parse took and the number of heap allocations it made.  Allocations are counted by
+// interposing malloc, calloc and realloc so those made by GLib are counted as well as those
+// made through operator new.
+//
+//  single pass     the file as written by the settings implementations.
+//  key file        the same file parsed with GKeyFile.
+//  fallback        a file with syntax the single pass parser doesn't handle, which is parsed by
+//                  both.
+
+#include "benchmark.h"
+
+#include <settingswatcher.h>
+
+#include <QCommandLineParser>
+
+#include <atomic>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+}
+
+static std::atomic<qint64> allocationCount(0);
+
+extern "C" void *malloc(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+
+using namespace NemoDeviceLock;
+
+static const char settingsFile[] =
+        "[desktop]\n"
+        "nemo\\devicelock\\automatic_locking=5\n"
+        "nemo\\devicelock\\code_current_length=5\n"
+        "nemo\\devicelock\\code_min_length=5\n"
+        "nemo\\devicelock\\code_max_length=42\n"
+        "nemo\\devicelock\\maximum_attempts=-1\n"
+        "nemo\\devicelock\\current_attempts=0\n"
+        "nemo\\devicelock\\peeking_allowed=1\n"
+        "nemo\\devicelock\\sideloading_allowed=-1\n"
+        "nemo\\devicelock\\show_notification=1\n"
+        "nemo\\devicelock\\code_input_is_keyboard=false\n"
+        "nemo\\devicelock\\code_current_is_digit_only=true\n"
+        "nemo\\devicelock\\encrypt_home=true\n"
+        "nemo\\devicelock\\maximum_automatic_locking=-1\n"
+        "nemo\\devicelock\\absolute_maximum_attempts=-1\n"
+        "nemo\\devicelock\\supported_device_reset_options=Shutdown,Reboot,WipeDevice\n"
+        "nemo\\devicelock\\code_is_mandatory=false\n"
+        "nemo\\devicelock\\code_generation=NoCodeGeneration\n";
+
+// An escape sequence in a value, which only GKeyFile unescapes.
+static const char unusualSettingsFile[] =
+        "[desktop]\n"
+        "nemo\\devicelock\\automatic_locking=5\n"
+        "nemo\\devicelock\\code_min_length=5\n"
+        "nemo\\devicelock\\code_max_length=42\n"
+        "nemo\\devicelock\\maximum_attempts=-1\n"
+        "nemo\\devicelock\\supported_device_reset_options=Shutdown,Reboot,\\sWipeDevice\n"
+        "nemo\\devicelock\\code_is_mandatory=false\n";
+
+struct ParseCost
+{
+    Benchmark::Samples duration;
+    Benchmark::Samples allocations;
+};
+
+template <typename Parse>
+static void measure(ParseCost *cost, const Parse &parse)
+{
+    SettingsValues values = {};
+
+    QElapsedTimer timer;
+    timer.start();
+    const qint64 allocations = allocationCount.load();
+
+    parse(&values);
+
+    cost->allocations.record(allocationCount.load() - allocations);
+    cost->duration.record(timer.nsecsElapsed());
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Device lock settings parser benchmark"));
+    parser.addHelpOption();
+
+    const QCommandLineOption iterationsOption(
+                QStringLiteral("iterations"),
+                QStringLiteral("The number of times the file is parsed by each parser."),
+                QStringLiteral("count"),
+                QStringLiteral("10000"));
+
+    parser.addOption(iterationsOption);
+    parser.process(application);
+
+    const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+
+    const int size = sizeof(settingsFile) - 1;
+    const int unusualSize = sizeof(unusualSettingsFile) - 1;
+
+    {
+        SettingsValues values = {};
+        if (!parseSettings(settingsFile, size, &values)) {
+            std::fprintf(stderr, "The single pass parser didn't accept the settings file\n");
+            return EXIT_FAILURE;
+        } else if (parseSettings(unusualSettingsFile, unusualSize, &values)) {
+            std::fprintf(stderr, "The single pass parser accepted the unusual settings file\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    ParseCost singlePass;
+    ParseCost keyFile;
+    ParseCost fallback;
+
+    for (int i = 0; i < iterations; ++i) {
+        measure(&singlePass, [&](SettingsValues *values) {
+            parseSettings(settingsFile, size, values);
+        });
+        measure(&keyFile, [&](SettingsValues *values) {
+            parseSettingsWithKeyFile(settingsFile, size, values);
+        });
+        measure(&fallback, [&](SettingsValues *values) {
+            if (!parseSettings(unusualSettingsFile, unusualSize, values)) {
+                parseSettingsWithKeyFile(unusualSettingsFile, unusualSize, values);
+            }
+        });
+    }
+
+    Benchmark::printHeader("Parse duration", "ns");
+    Benchmark::print("single pass", singlePass.duration);
+    Benchmark::print("key file", keyFile.duration);
+    Benchmark::print("fallback", fallback.duration);
+
+    Benchmark::printHeader("Allocations per parse", "");
+    Benchmark::print("single pass", singlePass.allocations);
+    Benchmark::print("key file", keyFile.allocations);
+    Benchmark::print("fallback", fallback.allocations);
+
+    return EXIT_SUCCESS;
+}
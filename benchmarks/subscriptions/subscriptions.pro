@@ -0,0 +1,9 @@
+TEMPLATE = app
+TARGET = tst_devicelock-subscriptions
+
+CONFIG += testcase
+
+include(../common/common.pri)
+
+SOURCES = \
+        tst_subscriptions.cpp
@@ -0,0 +1,434 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+// Verifies that a connection which has subscribed to some interfaces isn't sent, and so isn't
+// woken by, the signals of others, that the signals of objects it hasn't subscribed to are still
+// sent, and counts the wakeups that saves across a lock and unlock.
+//
+// The connections are opened in process with libdbus and pumped by the test, so every message
+// written to a connection is counted whether or not a client library would have handled it.
+
+#include "benchmark.h"
+
+#include <hostobject.h>
+#include <hostservice.h>
+
+#include <QtTest>
+
+#include <dbus/dbus.h>
+
+using namespace NemoDeviceLock;
+
+static const auto subscriptionInterface = QStringLiteral("org.nemomobile.devicelock.Subscription");
+static const auto deviceLockInterface = QStringLiteral("org.nemomobile.devicelock.DeviceLock");
+static const auto settingsInterface = QStringLiteral("org.nemomobile.devicelock.DeviceLockSettings");
+static const auto sentinelInterface = QStringLiteral("org.nemomobile.devicelock.Test");
+
+static const auto objectPath = QStringLiteral("/devicelock/test");
+static const auto settingsObjectPath = QStringLiteral("/devicelock/testsettings");
+
+// Stands in for an object which publishes the lock state and settings of the device on every
+// connection.
+class TestObject : public HostObject
+{
+public:
+    explicit TestObject(const QString &path = objectPath)
+        : HostObject(path)
+    {
+        setPropertyChangesCoalesced(false);
+    }
+
+    void clientConnected(const QString &connectionName) override
+    {
+        HostObject::clientConnected(connectionName);
+
+        ++connected;
+    }
+
+    void setLocked(bool locked)
+    {
+        propertyChanged(deviceLockInterface, QStringLiteral("State"), locked ? 1 : 0);
+    }
+
+    void changeSetting()
+    {
+        propertyChanged(settingsInterface, QStringLiteral("AutomaticLocking"), 5);
+    }
+
+    // Every connection registered is sent this and the signals sent before it arrive first.
+    void sendSentinel()
+    {
+        broadcastSignal(sentinelInterface, QStringLiteral("Sentinel"), QVariantList());
+    }
+
+    int connected = 0;
+};
+
+class Client
+{
+public:
+    explicit Client(const QString &address)
+    {
+        DBusError error;
+        dbus_error_init(&error);
+
+        m_connection = dbus_connection_open_private(address.toUtf8().constData(), &error);
+        if (m_connection) {
+            dbus_connection_set_exit_on_disconnect(m_connection, FALSE);
+        } else {
+            qWarning("Failed to connect to %s: %s", qPrintable(address), error.message);
+            dbus_error_free(&error);
+        }
+    }
+
+    ~Client()
+    {
+        if (m_connection) {
+            dbus_connection_close(m_connection);
+            dbus_connection_unref(m_connection);
+        }
+    }
+
+    bool isAuthenticated()
+    {
+        if (!m_connection) {
+            return false;
+        } else if (!dbus_connection_get_is_authenticated(m_connection)) {
+            // Authentication needs the client to write as well as read.
+            dbus_connection_read_write(m_connection, 0);
+            return false;
+        }
+        return true;
+    }
+
+    void subscribe(const QString &interface, const char *method = "Subscribe")
+    {
+        DBusMessage * const message = dbus_message_new_method_call(
+                    nullptr,
+                    objectPath.toUtf8().constData(),
+                    subscriptionInterface.toUtf8().constData(),
+                    method);
+        const QByteArray name = interface.toUtf8();
+        const char *data = name.constData();
+        dbus_message_append_args(message, DBUS_TYPE_STRING, &data, DBUS_TYPE_INVALID);
+        dbus_connection_send(m_connection, message, nullptr);
+        dbus_message_unref(message);
+
+        ++m_pendingReplies;
+    }
+
+    // Reads everything sent to the connection so far and returns whether it has received the
+    // sentinel signal and the replies to all its calls.
+    bool pump()
+    {
+        dbus_connection_read_write(m_connection, 0);
+
+        while (DBusMessage * const message = dbus_connection_pop_message(m_connection)) {
+            switch (dbus_message_get_type(message)) {
+            case DBUS_MESSAGE_TYPE_METHOD_RETURN:
+                --m_pendingReplies;
+                break;
+            case DBUS_MESSAGE_TYPE_ERROR:
+                qWarning("Call failed: %s", dbus_message_get_error_name(message));
+                --m_pendingReplies;
+                break;
+            case DBUS_MESSAGE_TYPE_SIGNAL:
+                if (sentinelInterface == QLatin1String(dbus_message_get_interface(message))) {
+                    m_sentinel = true;
+                } else {
+                    ++wakeups;
+                }
+                break;
+            default:
+                break;
+            }
+            dbus_message_unref(message);
+        }
+
+        return m_pendingReplies == 0 && m_sentinel;
+    }
+
+    bool isIdle() const { return m_pendingReplies == 0; }
+
+    void reset()
+    {
+        wakeups = 0;
+        m_sentinel = false;
+    }
+
+    int wakeups = 0;
+
+private:
+    DBusConnection *m_connection = nullptr;
+    int m_pendingReplies = 0;
+    bool m_sentinel = false;
+};
+
+class tst_Subscriptions : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void unsubscribedSignals();
+    void sharedConnection();
+    void lockCycleWakeups_data();
+    void lockCycleWakeups();
+
+private:
+    QList<Client *> openClients(int count);
+    bool subscribe(
+            const QList<Client *> &clients,
+            const QStringList &interfaces,
+            const char *method = "Subscribe");
+    bool deliver(const QList<Client *> &clients);
+
+    QTemporaryDir m_directory;
+    QString m_address;
+    TestObject *m_object = nullptr;
+    TestObject *m_settingsObject = nullptr;
+    HostService *m_service = nullptr;
+};
+
+void tst_Subscriptions::initTestCase()
+{
+    QVERIFY(m_directory.isValid());
+
+    m_address = Benchmark::useHostDirectory(m_directory, QVariantMap());
+
+    m_object = new TestObject;
+    m_settingsObject = new TestObject(settingsObjectPath);
+    m_service = new HostService({ m_object, m_settingsObject });
+
+    QVERIFY(m_service->isConnected());
+}
+
+void tst_Subscriptions::cleanupTestCase()
+{
+    delete m_service;
+    delete m_settingsObject;
+    delete m_object;
+}
+
+QList<Client *> tst_Subscriptions::openClients(int count)
+{
+    const int connected = m_object->connected;
+    const int settingsConnected = m_settingsObject->connected;
+
+    QList<Client *> clients;
+    for (int i = 0; i < count; ++i) {
+        clients.append(new Client(m_address));
+    }
+
+    // Objects are registered on a connection on the main thread after it's authenticated, the
+    // clients can't subscribe before then.
+    const bool registered = Benchmark::waitUntil([&]() {
+        for (Client * const client : clients) {
+            if (!client->isAuthenticated()) {
+                return false;
+            }
+        }
+        return m_object->connected - connected >= count
+                && m_settingsObject->connected - settingsConnected >= count;
+    });
+
+    if (!registered) {
+        qDeleteAll(clients);
+        clients.clear();
+    }
+
+    return clients;
+}
+
+bool tst_Subscriptions::subscribe(
+        const QList<Client *> &clients, const QStringList &interfaces, const char *method)
+{
+    for (Client * const client : clients) {
+        for (const QString &interface : interfaces) {
+            client->subscribe(interface, method);
+        }
+    }
+
+    return Benchmark::waitUntil([&]() {
+        for (Client * const client : clients) {
+            client->pump();
+            if (!client->isIdle()) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+// Sends the sentinel and reads from every client until they've all received it, by which time
+// they've received every signal sent before it.
+bool tst_Subscriptions::deliver(const QList<Client *> &clients)
+{
+    m_object->sendSentinel();
+
+    return Benchmark::waitUntil([&]() {
+        bool delivered = true;
+        for (Client * const client : clients) {
+            delivered = client->pump() && delivered;
+        }
+        return delivered;
+    });
+}
+
+void tst_Subscriptions::unsubscribedSignals()
+{
+    const QList<Client *> clients = openClients(2);
+    QCOMPARE(clients.count(), 2);
+
+    Client * const lockClient = clients.at(0);
+    Client * const settingsClient = clients.at(1);
+
+    QVERIFY(subscribe({ lockClient }, { deviceLockInterface, sentinelInterface }));
+    QVERIFY(subscribe({ settingsClient }, { settingsInterface, sentinelInterface }));
+
+    lockClient->reset();
+    settingsClient->reset();
+
+    m_object->setLocked(true);
+    QVERIFY(deliver(clients));
+
+    QCOMPARE(lockClient->wakeups, 1);
+    QCOMPARE(settingsClient->wakeups, 0);
+
+    lockClient->reset();
+    settingsClient->reset();
+
+    m_object->changeSetting();
+    QVERIFY(deliver(clients));
+
+    QCOMPARE(lockClient->wakeups, 0);
+    QCOMPARE(settingsClient->wakeups, 1);
+
+    qDeleteAll(clients);
+}
+
+// A device lock client which has subscribed to the lock state sharing a connection with a
+// settings client which uses another object and hasn't subscribed to anything.  The settings
+// client still receives the signals of its object, and once the device lock client has
+// unsubscribed from everything the connection receives all the signals of the first object again.
+void tst_Subscriptions::sharedConnection()
+{
+    const QList<Client *> clients = openClients(1);
+    QCOMPARE(clients.count(), 1);
+
+    Client * const client = clients.first();
+
+    QVERIFY(subscribe(clients, { deviceLockInterface, sentinelInterface }));
+
+    client->reset();
+
+    m_settingsObject->changeSetting();
+    QVERIFY(deliver(clients));
+
+    QCOMPARE(client->wakeups, 1);
+
+    client->reset();
+
+    m_object->changeSetting();
+    QVERIFY(deliver(clients));
+
+    QCOMPARE(client->wakeups, 0);
+
+    QVERIFY(subscribe(clients, { deviceLockInterface, sentinelInterface }, "Unsubscribe"));
+
+    client->reset();
+
+    m_object->changeSetting();
+    QVERIFY(deliver(clients));
+
+    QCOMPARE(client->wakeups, 1);
+
+    qDeleteAll(clients);
+}
+
+void tst_Subscriptions::lockCycleWakeups_data()
+{
+    QTest::addColumn<int>("idleCount");
+
+    QTest::newRow("10") << 10;
+    QTest::newRow("100") << 100;
+}
+
+// A lock screen subscribed to the lock state among idle applications which only use settings,
+// and the same applications had they never subscribed and so received every signal.
+void tst_Subscriptions::lockCycleWakeups()
+{
+    QFETCH(int, idleCount);
+
+    const QList<Client *> clients = openClients(1 + 2 * idleCount);
+    QCOMPARE(clients.count(), 1 + 2 * idleCount);
+
+    Client * const lockScreen = clients.first();
+    const QList<Client *> subscribed = clients.mid(1, idleCount);
+    const QList<Client *> unsubscribed = clients.mid(1 + idleCount);
+
+    QVERIFY(subscribe({ lockScreen }, { deviceLockInterface, sentinelInterface }));
+    QVERIFY(subscribe(subscribed, { settingsInterface, sentinelInterface }));
+
+    for (Client * const client : clients) {
+        client->reset();
+    }
+
+    m_object->setLocked(true);
+    m_object->setLocked(false);
+    QVERIFY(deliver(clients));
+
+    int subscribedWakeups = 0;
+    for (Client * const client : subscribed) {
+        subscribedWakeups += client->wakeups;
+    }
+
+    int unsubscribedWakeups = 0;
+    for (Client * const client : unsubscribed) {
+        unsubscribedWakeups += client->wakeups;
+    }
+
+    QCOMPARE(lockScreen->wakeups, 2);
+    QCOMPARE(subscribedWakeups, 0);
+    QCOMPARE(unsubscribedWakeups, 2 * idleCount);
+
+    qInfo("%i idle clients: %i wakeups per lock and unlock when subscribed, %i when not",
+                idleCount, subscribedWakeups, unsubscribedWakeups);
+
+    qDeleteAll(clients);
+}
+
+QTEST_GUILESS_MAIN(tst_Subscriptions)
+
+#include "tst_subscriptions.moc"
@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+// Measures the end to end latency of unlocking the device and of authenticating, from a client
+// entering a security code to the client seeing the result.
+//
+// The benchmark hosts the real CliDeviceLock and CliAuthenticator on a private socket in its own
+// process and drives DeviceLock, Authenticator and AuthenticationInput clients connected to that
+// socket.  The plugin is devicelock-fake-plugin, with a configurable delay standing in for the
+// time a real plugin takes to check a code.  Each cycle is split into phases:
+//
+//  transit         the client entering the code to the host receiving it.
+//  plugin          the host receiving the code to the host applying the plugin's result.
+//  propagation     the host applying the result to the client receiving the state change or the
+//                  authentication token.
+
+#include "benchmark.h"
+
+#include <cliauthenticator.h>
+#include <clidevicelock.h>
+#include <hostservice.h>
+
+#include <nemo-devicelock/authenticationinput.h>
+#include <nemo-devicelock/authenticator.h>
+#include <nemo-devicelock/devicelock.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+
+using namespace NemoDeviceLock;
+using Benchmark::now;
+
+static const auto securityCode = QStringLiteral("12345");
+
+static qint64 hostReceived = 0;
+static qint64 hostCompleted = 0;
+
+class BenchmarkDeviceLock : public CliDeviceLock
+{
+public:
+    int unlockWithCode(const QString &code) override
+    {
+        hostReceived = now();
+        return CliDeviceLock::unlockWithCode(code);
+    }
+
+protected:
+    void stateChanged() override
+    {
+        const qint64 timestamp = now();
+
+        CliDeviceLock::stateChanged();
+
+        if (state() == DeviceLock::Unlocked) {
+            hostCompleted = timestamp;
+        }
+    }
+};
+
+class BenchmarkAuthenticator : public CliAuthenticator
+{
+public:
+    int checkCode(const QString &code) override
+    {
+        hostReceived = now();
+        return CliAuthenticator::checkCode(code);
+    }
+
+    void confirmAuthentication(Authenticator::Method method) override
+    {
+        hostCompleted = now();
+        CliAuthenticator::confirmAuthentication(method);
+    }
+};
+
+struct Phases
+{
+    void record(qint64 entered, qint64 clientCompleted)
+    {
+        transit.record(hostReceived - entered);
+        plugin.record(hostCompleted - hostReceived);
+        propagation.record(clientCompleted - hostCompleted);
+        total.record(clientCompleted - entered);
+    }
+
+    void print(const char *title)
+    {
+        Benchmark::printHeader(title);
+        Benchmark::print("transit", transit);
+        Benchmark::print("plugin", plugin);
+        Benchmark::print("propagation", propagation);
+        Benchmark::print("total", total);
+    }
+
+    Benchmark::Samples transit;
+    Benchmark::Samples plugin;
+    Benchmark::Samples propagation;
+    Benchmark::Samples total;
+};
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Device lock unlock and authentication latency benchmark"));
+    parser.addHelpOption();
+
+    const QCommandLineOption iterationsOption(
+                QStringLiteral("iterations"),
+                QStringLiteral("The number of unlock and authentication cycles."),
+                QStringLiteral("count"),
+                QStringLiteral("100"));
+    const QCommandLineOption delayOption(
+                QStringLiteral("plugin-delay"),
+                QStringLiteral("The time in milliseconds the fake plugin takes to check a code."),
+                QStringLiteral("milliseconds"),
+                QStringLiteral("0"));
+    const QCommandLineOption persistentOption(
+                QStringLiteral("persistent"),
+                QStringLiteral("Keep a persistent plugin process instead of starting one per request."));
+    const QCommandLineOption pluginOption(
+                QStringLiteral("plugin"),
+                QStringLiteral("The fake plugin executable."),
+                QStringLiteral("path"),
+                QCoreApplication::applicationDirPath() + QStringLiteral("/devicelock-fake-plugin"));
+
+    parser.addOption(iterationsOption);
+    parser.addOption(delayOption);
+    parser.addOption(persistentOption);
+    parser.addOption(pluginOption);
+    parser.process(application);
+
+    const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+
+    // The host reads its configuration and socket address when it's constructed.
+    QTemporaryDir directory;
+    Benchmark::useHostDirectory(directory, {
+        { QStringLiteral("DeviceLock/pluginName"), parser.value(pluginOption) },
+        { QStringLiteral("DeviceLock/persistent"), parser.isSet(persistentOption) }
+    });
+
+    qputenv("NEMODEVICELOCK_FAKE_PLUGIN_CODE", securityCode.toUtf8());
+    qputenv("NEMODEVICELOCK_FAKE_PLUGIN_DELAY", parser.value(delayOption).toUtf8());
+
+    BenchmarkAuthenticator hostAuthenticator;
+    BenchmarkDeviceLock hostDeviceLock;
+    HostService service({ &hostAuthenticator, &hostDeviceLock });
+
+    DeviceLock deviceLock;
+    Authenticator authenticator;
+    AuthenticationInput unlockInput(AuthenticationInput::DeviceLock);
+    AuthenticationInput authenticationInput(AuthenticationInput::Authentication);
+
+    unlockInput.setRegistered(true);
+    unlockInput.setActive(true);
+    authenticationInput.setRegistered(true);
+    authenticationInput.setActive(true);
+
+    qint64 clientCompleted = 0;
+    QObject::connect(&deviceLock, &DeviceLock::stateChanged, [&]() {
+        if (deviceLock.state() == DeviceLock::Unlocked) {
+            clientCompleted = now();
+        }
+    });
+    QObject::connect(&authenticator, &Authenticator::authenticated, [&]() {
+        clientCompleted = now();
+    });
+
+    if (!Benchmark::waitUntil(&deviceLock, &DeviceLock::stateChanged, [&]() {
+        return deviceLock.state() == DeviceLock::Locked;
+    })) {
+        qWarning("The device lock didn't report a locked state, is %s executable?",
+                    qPrintable(parser.value(pluginOption)));
+        return EXIT_FAILURE;
+    }
+
+    Phases unlock;
+    Phases authenticate;
+
+    for (int i = 0; i < iterations; ++i) {
+        hostDeviceLock.setLocked(true);
+
+        const bool locked = Benchmark::waitUntil(&deviceLock, &DeviceLock::stateChanged, [&]() {
+            return deviceLock.state() == DeviceLock::Locked;
+        });
+
+        deviceLock.unlock();
+
+        if (!locked || !Benchmark::waitUntil(&unlockInput, &AuthenticationInput::statusChanged, [&]() {
+            return unlockInput.status() == AuthenticationInput::Authenticating;
+        })) {
+            qWarning("Unlock %i didn't start", i);
+            return EXIT_FAILURE;
+        }
+
+        hostReceived = hostCompleted = clientCompleted = 0;
+
+        const qint64 entered = now();
+        unlockInput.enterSecurityCode(securityCode);
+
+        if (!Benchmark::waitUntil(&deviceLock, &DeviceLock::stateChanged, [&]() {
+            return clientCompleted != 0;
+        }) || !Benchmark::waitUntil(&unlockInput, &AuthenticationInput::statusChanged, [&]() {
+            return unlockInput.status() == AuthenticationInput::Idle;
+        })) {
+            qWarning("Unlock %i didn't complete", i);
+            return EXIT_FAILURE;
+        }
+
+        unlock.record(entered, clientCompleted);
+    }
+
+    for (int i = 0; i < iterations; ++i) {
+        authenticator.authenticate(QVariant::fromValue(i), Authenticator::SecurityCode);
+
+        if (!Benchmark::waitUntil(&authenticationInput, &AuthenticationInput::statusChanged, [&]() {
+            return authenticationInput.status() == AuthenticationInput::Authenticating;
+        })) {
+            qWarning("Authentication %i didn't start", i);
+            return EXIT_FAILURE;
+        }
+
+        hostReceived = hostCompleted = clientCompleted = 0;
+
+        const qint64 entered = now();
+        authenticationInput.enterSecurityCode(securityCode);
+
+        if (!Benchmark::waitUntil(&authenticator, &Authenticator::authenticated, [&]() {
+            return clientCompleted != 0;
+        }) || !Benchmark::waitUntil(&authenticationInput, &AuthenticationInput::statusChanged, [&]() {
+            return authenticationInput.status() == AuthenticationInput::Idle;
+        })) {
+            qWarning("Authentication %i didn't complete", i);
+            return EXIT_FAILURE;
+        }
+
+        authenticate.record(entered, clientCompleted);
+    }
+
+    std::printf("%i iterations, %s plugin, %sms plugin delay\n",
+                iterations,
+                parser.isSet(persistentOption) ? "persistent" : "one-shot",
+                qPrintable(parser.value(delayOption)));
+
+    unlock.print("Unlock");
+    authenticate.print("Authenticate");
+
+    return EXIT_SUCCESS;
+}
@@ -7,8 +7,10 @@ OTHER_FILES += \
         $$PWD/org.nemomobile.devicelock.DeviceLock.xml \
         $$PWD/org.nemomobile.devicelock.DeviceLock.Settings.xml \
         $$PWD/org.nemomobile.devicelock.DeviceReset.xml \
+        $$PWD/org.nemomobile.devicelock.Diagnostics.xml \
         $$PWD/org.nemomobile.devicelock.EncryptionSettings.xml \
         $$PWD/org.nemomobile.devicelock.Fingerprint.Sensor.xml \
         $$PWD/org.nemomobile.devicelock.Fingerprint.Settings.xml \
+        $$PWD/org.nemomobile.devicelock.Subscription.xml \
         $$PWD/org.nemomobile.devicelock.LockCodeSettings.xml
 
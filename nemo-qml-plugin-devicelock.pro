@@ -1,6 +1,10 @@
 TEMPLATE = subdirs
 
 SUBDIRS = \
+        src \
+        benchmarks
+
+benchmarks.depends = \
         src
 
 OTHER_FILES += \
@@ -34,12 +34,14 @@
 #include <clidevicelock.h>
 #include <clidevicelocksettings.h>
 #include <clidevicereset.h>
+#include <clidiagnostics.h>
 #include <cliencryptionsettings.h>
 #include <hostfingerprintsensor.h>
 #include <hostfingerprintsettings.h>
 #include <hostservice.h>
 
 #include <QCoreApplication>
+#include <QSettings>
 
 int main(int argc, char *argv[])
 {
@@ -62,5 +64,13 @@ int main(int argc, char *argv[])
                 &fingerprintSensor,
                 &fingerprintSettings);
 
+    const QSettings settings(
+                QStringLiteral("/usr/share/lipstick/devicelock/devicelock.conf"), QSettings::IniFormat);
+    service.setLazyRegistration(
+                settings.value(QStringLiteral("DeviceLock/lazyRegistration"), false).toBool());
+
+    NemoDeviceLock::CliDiagnostics diagnostics(
+                &service, &authenticator, &deviceLock, &deviceLockSettings);
+
     return application.exec();
 }
@@ -244,6 +244,7 @@ void DeviceLock::handleNotice(uint notice, const QVariantMap &data)
 void DeviceLock::connected()
 {
     registerObject();
+    subscribe();
 
     connectToSignal(QStringLiteral("Notice"), SLOT(handleNotice(uint,QVariantMap)));
 
@@ -32,6 +32,7 @@
 
 #include "devicelocksettings.h"
 
+#include "logging.h"
 #include "settingswatcher.h"
 
 namespace NemoDeviceLock
@@ -248,6 +249,51 @@ void DeviceLockSettings::setInputIsKeyboard(const QVariant &authenticationToken,
     changeSetting(authenticationToken, QString::fromUtf8(SettingsWatcher::inputIsKeyboardKey), value);
 }
 
+/*!
+    Sets new values for multiple settings at once.
+
+    The \a settings map is keyed by the names of the settable properties; automaticLocking,
+    maximumAttempts, peekingAllowed, sideloadingAllowed, showNotifications and inputIsKeyboard.
+    All the values are applied together, which is cheaper than setting each individually.
+
+    The settings authorization challenge code must be authenticated before this is called and the
+    \a authenticationToken produced passed as an argument.
+*/
+
+void DeviceLockSettings::changeSettings(const QVariant &authenticationToken, const QVariantMap &settings)
+{
+    if (m_authorization.status() != Authorization::ChallengeIssued) {
+        return;
+    }
+
+    static const QString prefix = QStringLiteral("/desktop/nemo/devicelock/");
+
+    QVariantMap values;
+    for (auto it = settings.constBegin(); it != settings.constEnd(); ++it) {
+        const QString &name = it.key();
+
+        if (name == QLatin1String("automaticLocking")) {
+            values.insert(prefix + QString::fromUtf8(SettingsWatcher::automaticLockingKey), it.value().toInt());
+        } else if (name == QLatin1String("maximumAttempts")) {
+            values.insert(prefix + QString::fromUtf8(SettingsWatcher::maximumAttemptsKey), it.value().toInt());
+        } else if (name == QLatin1String("peekingAllowed")) {
+            values.insert(prefix + QString::fromUtf8(SettingsWatcher::peekingAllowedKey), it.value().toBool() ? 1 : 0);
+        } else if (name == QLatin1String("sideloadingAllowed")) {
+            values.insert(prefix + QString::fromUtf8(SettingsWatcher::sideloadingAllowedKey), it.value().toBool() ? 1 : 0);
+        } else if (name == QLatin1String("showNotifications")) {
+            values.insert(prefix + QString::fromUtf8(SettingsWatcher::showNotificationsKey), it.value().toBool() ? 1 : 0);
+        } else if (name == QLatin1String("inputIsKeyboard")) {
+            values.insert(prefix + QString::fromUtf8(SettingsWatcher::inputIsKeyboardKey), it.value().toBool());
+        } else {
+            qCWarning(devicelock, "Unknown device lock setting %s.", qPrintable(name));
+        }
+    }
+
+    if (!values.isEmpty()) {
+        call(QStringLiteral("ChangeSettings"), m_localPath, authenticationToken, values);
+    }
+}
+
 /*!
     \property NemoDeviceLock::DeviceLockSettings::currentCodeIsDigitOnly
 
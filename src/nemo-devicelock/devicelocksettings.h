@@ -81,6 +81,8 @@ public:
     bool inputIsKeyboard() const;
     Q_INVOKABLE void setInputIsKeyboard(const QVariant &authenticationToken, bool value);
 
+    Q_INVOKABLE void changeSettings(const QVariant &authenticationToken, const QVariantMap &settings);
+
     bool currentCodeIsDigitOnly() const;
     int currentCodeLength() const;
     int minimumCodeLength() const;
@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "broadcastmessage.h"
+
+#include <QDBusObjectPath>
+#include <QDBusVariant>
+#include <QStringList>
+
+#include <dbus/dbus.h>
+
+namespace NemoDeviceLock
+{
+
+// The D-Bus signature of a value, or an empty string if the value is of a type which isn't
+// encoded by appendValue().
+static QByteArray signature(const QVariant &value)
+{
+    switch (value.userType()) {
+    case QMetaType::Bool:
+        return DBUS_TYPE_BOOLEAN_AS_STRING;
+    case QMetaType::Int:
+        return DBUS_TYPE_INT32_AS_STRING;
+    case QMetaType::UInt:
+        return DBUS_TYPE_UINT32_AS_STRING;
+    case QMetaType::LongLong:
+        return DBUS_TYPE_INT64_AS_STRING;
+    case QMetaType::ULongLong:
+        return DBUS_TYPE_UINT64_AS_STRING;
+    case QMetaType::Double:
+        return DBUS_TYPE_DOUBLE_AS_STRING;
+    case QMetaType::QString:
+        return DBUS_TYPE_STRING_AS_STRING;
+    case QMetaType::QStringList:
+        return DBUS_TYPE_ARRAY_AS_STRING DBUS_TYPE_STRING_AS_STRING;
+    case QMetaType::QVariantMap:
+        for (const auto &item : value.value<QVariantMap>()) {
+            if (signature(item).isEmpty()) {
+                return QByteArray();
+            }
+        }
+        return DBUS_TYPE_ARRAY_AS_STRING
+                DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+                DBUS_TYPE_STRING_AS_STRING
+                DBUS_TYPE_VARIANT_AS_STRING
+                DBUS_DICT_ENTRY_END_CHAR_AS_STRING;
+    default:
+        if (value.userType() == qMetaTypeId<QDBusObjectPath>()) {
+            return DBUS_TYPE_OBJECT_PATH_AS_STRING;
+        } else if (value.userType() == qMetaTypeId<QDBusVariant>()) {
+            return signature(value.value<QDBusVariant>().variant()).isEmpty()
+                    ? QByteArray()
+                    : QByteArray(DBUS_TYPE_VARIANT_AS_STRING);
+        } else {
+            return QByteArray();
+        }
+    }
+}
+
+static void appendValue(DBusMessageIter *iterator, const QVariant &value);
+
+static void appendString(DBusMessageIter *iterator, int type, const QString &value)
+{
+    const QByteArray data = value.toUtf8();
+    const char *string = data.constData();
+
+    dbus_message_iter_append_basic(iterator, type, &string);
+}
+
+static void appendVariant(DBusMessageIter *iterator, const QVariant &value)
+{
+    DBusMessageIter variant;
+
+    dbus_message_iter_open_container(iterator, DBUS_TYPE_VARIANT, signature(value).constData(), &variant);
+    appendValue(&variant, value);
+    dbus_message_iter_close_container(iterator, &variant);
+}
+
+template <typename T> static void appendBasic(DBusMessageIter *iterator, int type, T value)
+{
+    dbus_message_iter_append_basic(iterator, type, &value);
+}
+
+static void appendValue(DBusMessageIter *iterator, const QVariant &value)
+{
+    switch (value.userType()) {
+    case QMetaType::Bool:
+        appendBasic<dbus_bool_t>(iterator, DBUS_TYPE_BOOLEAN, value.toBool());
+        break;
+    case QMetaType::Int:
+        appendBasic<dbus_int32_t>(iterator, DBUS_TYPE_INT32, value.toInt());
+        break;
+    case QMetaType::UInt:
+        appendBasic<dbus_uint32_t>(iterator, DBUS_TYPE_UINT32, value.toUInt());
+        break;
+    case QMetaType::LongLong:
+        appendBasic<dbus_int64_t>(iterator, DBUS_TYPE_INT64, value.toLongLong());
+        break;
+    case QMetaType::ULongLong:
+        appendBasic<dbus_uint64_t>(iterator, DBUS_TYPE_UINT64, value.toULongLong());
+        break;
+    case QMetaType::Double:
+        appendBasic<double>(iterator, DBUS_TYPE_DOUBLE, value.toDouble());
+        break;
+    case QMetaType::QString:
+        appendString(iterator, DBUS_TYPE_STRING, value.toString());
+        break;
+    case QMetaType::QStringList: {
+        DBusMessageIter array;
+        dbus_message_iter_open_container(iterator, DBUS_TYPE_ARRAY, DBUS_TYPE_STRING_AS_STRING, &array);
+        for (const auto &string : value.toStringList()) {
+            appendString(&array, DBUS_TYPE_STRING, string);
+        }
+        dbus_message_iter_close_container(iterator, &array);
+        break;
+    }
+    case QMetaType::QVariantMap: {
+        const QVariantMap map = value.value<QVariantMap>();
+
+        DBusMessageIter array;
+        dbus_message_iter_open_container(
+                    iterator,
+                    DBUS_TYPE_ARRAY,
+                    DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+                    DBUS_TYPE_STRING_AS_STRING
+                    DBUS_TYPE_VARIANT_AS_STRING
+                    DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
+                    &array);
+        for (auto it = map.begin(); it != map.end(); ++it) {
+            DBusMessageIter entry;
+            dbus_message_iter_open_container(&array, DBUS_TYPE_DICT_ENTRY, nullptr, &entry);
+            appendString(&entry, DBUS_TYPE_STRING, it.key());
+            appendVariant(&entry, it.value());
+            dbus_message_iter_close_container(&array, &entry);
+        }
+        dbus_message_iter_close_container(iterator, &array);
+        break;
+    }
+    default:
+        if (value.userType() == qMetaTypeId<QDBusObjectPath>()) {
+            appendString(iterator, DBUS_TYPE_OBJECT_PATH, value.value<QDBusObjectPath>().path());
+        } else if (value.userType() == qMetaTypeId<QDBusVariant>()) {
+            appendVariant(iterator, value.value<QDBusVariant>().variant());
+        }
+        break;
+    }
+}
+
+BroadcastMessage::BroadcastMessage(
+        const QString &path,
+        const QString &interface,
+        const QString &name,
+        const QVariantList &arguments)
+    : m_message(QDBusMessage::createSignal(path, interface, name))
+    , m_encodedMessage(nullptr)
+{
+    m_message.setArguments(arguments);
+
+    // A property change is superseded by later changes of each of its properties.  The keys of
+    // a map are sorted so the keys derived from them are too.
+    if (interface == QLatin1String("org.freedesktop.DBus.Properties")
+            && name == QLatin1String("PropertiesChanged")
+            && arguments.count() == 3) {
+        const QString prefix = path + QLatin1Char(' ') + arguments.at(0).toString() + QLatin1Char(' ');
+        const QVariantMap properties = arguments.at(1).value<QVariantMap>();
+
+        for (auto it = properties.begin(); it != properties.end(); ++it) {
+            m_coalesceKeys.append(prefix + it.key());
+        }
+    }
+
+    for (const auto &argument : arguments) {
+        if (signature(argument).isEmpty()) {
+            return;
+        }
+    }
+
+    m_encodedMessage = dbus_message_new_signal(
+                path.toUtf8().constData(), interface.toUtf8().constData(), name.toUtf8().constData());
+
+    if (m_encodedMessage) {
+        DBusMessageIter iterator;
+        dbus_message_iter_init_append(m_encodedMessage, &iterator);
+
+        for (const auto &argument : arguments) {
+            appendValue(&iterator, argument);
+        }
+    }
+}
+
+BroadcastMessage::~BroadcastMessage()
+{
+    if (m_encodedMessage) {
+        dbus_message_unref(m_encodedMessage);
+    }
+}
+
+bool BroadcastMessage::isEncoded() const
+{
+    return m_encodedMessage;
+}
+
+DBusMessage *BroadcastMessage::encodedMessage() const
+{
+    return m_encodedMessage;
+}
+
+const QDBusMessage &BroadcastMessage::message() const
+{
+    return m_message;
+}
+
+QStringList BroadcastMessage::coalesceKeys() const
+{
+    return m_coalesceKeys;
+}
+
+}
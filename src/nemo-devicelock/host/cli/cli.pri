@@ -6,15 +6,24 @@ PUBLIC_HEADERS += \
         $$PWD/clidevicelock.h \
         $$PWD/clidevicelocksettings.h \
         $$PWD/clidevicereset.h \
-        $$PWD/cliencryptionsettings.h
+        $$PWD/clidiagnostics.h \
+        $$PWD/cliencryptionsettings.h \
+        $$PWD/cliplugin.h
 
 HEADERS +=  \
-        $$PWD/lockcodewatcher.h
+        $$PWD/lockcodewatcher.h \
+        $$PWD/pluginlibrary.h \
+        $$PWD/pluginprocess.h \
+        $$PWD/pluginscheduler.h
 
 SOURCES += \
         $$PWD/cliauthenticator.cpp \
         $$PWD/clidevicelock.cpp \
         $$PWD/clidevicelocksettings.cpp \
         $$PWD/clidevicereset.cpp \
+        $$PWD/clidiagnostics.cpp \
         $$PWD/cliencryptionsettings.cpp \
-        $$PWD/lockcodewatcher.cpp
+        $$PWD/lockcodewatcher.cpp \
+        $$PWD/pluginlibrary.cpp \
+        $$PWD/pluginprocess.cpp \
+        $$PWD/pluginscheduler.cpp
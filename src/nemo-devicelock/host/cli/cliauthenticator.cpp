@@ -83,17 +83,44 @@ HostAuthenticationInput::Availability CliAuthenticator::availability(QVariantMap
 
 int CliAuthenticator::checkCode(const QString &code)
 {
-    return m_watcher->runPlugin(QStringList() << QStringLiteral("--check-code") << code);
+    m_checkCall = m_watcher->invokePlugin(QStringList() << QStringLiteral("--check-code") << code);
+    m_checkCall->onFinished(this, [this, code](int result) {
+        // The code is also the authentication token, restore it for the duration of the callback.
+        m_securityCode = code;
+        checkCodeFinished(result);
+        m_securityCode.clear();
+    });
+
+    return Evaluating;
 }
 
 int CliAuthenticator::setCode(const QString &oldCode, const QString &newCode)
 {
-    return m_watcher->runPlugin(QStringList() << QStringLiteral("--set-code") << oldCode << newCode);
+    m_watcher->invokePlugin(QStringList() << QStringLiteral("--set-code") << oldCode << newCode)->onFinished(
+                this, [this, newCode](int result) {
+        m_securityCode = newCode;
+        setCodeFinished(result);
+        m_securityCode.clear();
+    });
+
+    return Evaluating;
 }
 
-bool CliAuthenticator::clearCode(const QString &code)
+int CliAuthenticator::clearCode(const QString &code)
 {
-    return m_watcher->runPlugin(QStringList() << QStringLiteral("--clear-code") << code) == Success;
+    m_watcher->invokePlugin(QStringList() << QStringLiteral("--clear-code") << code)->onFinished(
+                this, [this](int result) {
+        clearCodeFinished(result);
+    });
+
+    return Evaluating;
+}
+
+void CliAuthenticator::abortCheckCode()
+{
+    if (m_checkCall) {
+        m_checkCall->cancel();
+    }
 }
 
 void CliAuthenticator::enterSecurityCode(const QString &code)
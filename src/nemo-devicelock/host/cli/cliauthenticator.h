@@ -36,12 +36,14 @@
 #include <nemo-devicelock/host/hostauthenticator.h>
 
 #include <QDBusConnection>
+#include <QPointer>
 #include <QSharedDataPointer>
 
 namespace NemoDeviceLock
 {
 
 class LockCodeWatcher;
+class PluginCall;
 
 class CliAuthenticator : public HostAuthenticator
 {
@@ -55,7 +57,8 @@ public:
 
     int checkCode(const QString &code) override;
     int setCode(const QString &oldCode, const QString &newCode) override;
-    bool clearCode(const QString &code) override;
+    int clearCode(const QString &code) override;
+    void abortCheckCode() override;
 
     void enterSecurityCode(const QString &code);
     QVariant authenticateChallengeCode(
@@ -63,6 +66,7 @@ public:
 
 private:
     QExplicitlySharedDataPointer<LockCodeWatcher> m_watcher;
+    QPointer<PluginCall> m_checkCall;
     QString m_securityCode;
 };
 
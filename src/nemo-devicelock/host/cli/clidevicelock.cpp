@@ -72,17 +72,47 @@ HostAuthenticationInput::Availability CliDeviceLock::availability(QVariantMap *)
 
 int CliDeviceLock::checkCode(const QString &code)
 {
-    return m_watcher->runPlugin(QStringList() << QStringLiteral("--check-code") << code);
+    m_checkCall = m_watcher->invokePlugin(QStringList() << QStringLiteral("--check-code") << code);
+    m_checkCall->onFinished(this, [this](int result) {
+        checkCodeFinished(result);
+    });
+
+    return Evaluating;
 }
 
 int CliDeviceLock::setCode(const QString &oldCode, const QString &newCode)
 {
-    return m_watcher->runPlugin(QStringList() << QStringLiteral("--set-code") << oldCode << newCode);
+    m_watcher->invokePlugin(QStringList() << QStringLiteral("--set-code") << oldCode << newCode)->onFinished(
+                this, [this](int result) {
+        setCodeFinished(result);
+    });
+
+    return Evaluating;
 }
 
 int CliDeviceLock::unlockWithCode(const QString &code)
 {
-    return m_watcher->runPlugin(QStringList() << QStringLiteral("--unlock") << code);
+    m_unlockCall = m_watcher->invokePlugin(QStringList() << QStringLiteral("--unlock") << code);
+    m_unlockCall->onFinished(this, [this](int result) {
+        unlockFinished(result, Authenticator::SecurityCode);
+    });
+
+    return Evaluating;
+}
+
+void CliDeviceLock::unlockAnticipated()
+{
+    m_watcher->prewarm();
+}
+
+void CliDeviceLock::abortCheckCode()
+{
+    if (m_checkCall) {
+        m_checkCall->cancel();
+    }
+    if (m_unlockCall) {
+        m_unlockCall->cancel();
+    }
 }
 
 }
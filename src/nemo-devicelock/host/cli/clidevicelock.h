@@ -35,12 +35,14 @@
 
 #include <nemo-devicelock/host/mcedevicelock.h>
 
+#include <QPointer>
 #include <QSharedDataPointer>
 
 namespace NemoDeviceLock
 {
 
 class LockCodeWatcher;
+class PluginCall;
 
 class CliDeviceLock : public MceDeviceLock
 {
@@ -54,9 +56,15 @@ public:
     int checkCode(const QString &code) override;
     int setCode(const QString &oldCode, const QString &newCode) override;
     int unlockWithCode(const QString &code) override;
+    void abortCheckCode() override;
+
+protected:
+    void unlockAnticipated() override;
 
 private:
     QExplicitlySharedDataPointer<LockCodeWatcher> m_watcher;
+    QPointer<PluginCall> m_checkCall;
+    QPointer<PluginCall> m_unlockCall;
     bool m_unlocking;
 };
 
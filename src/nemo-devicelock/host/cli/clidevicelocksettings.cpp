@@ -54,13 +54,85 @@ CliDeviceLockSettings::~CliDeviceLockSettings()
 void CliDeviceLockSettings::changeSetting(
         const QString &, const QVariant &authenticationToken, const QString &key, const QVariant &value)
 {
-    if (m_watcher->runPlugin(QStringList()
+    const QDBusMessage message = HostObject::message();
+    QDBusConnection connection = HostObject::connection();
+
+    HostObject::setDelayedReply(true);
+
+    const QStringList keyAndValue = QStringList() << key << value.toString();
+
+    m_watcher->invokePlugin(QStringList()
                 << QStringLiteral("--set-config-key")
                 << authenticationToken.toString()
-                << key
-                << value.toString()) != HostAuthenticationInput::Success) {
-        QDBusContext::sendErrorReply(QDBusError::InternalError);
+                << keyAndValue)->onFinished(this, [this, message, connection, keyAndValue](int result) mutable {
+        if (result == HostAuthenticationInput::Success) {
+            settingsWritten(keyAndValue);
+        }
+
+        sendMessage(connection.name(), result == HostAuthenticationInput::Success
+                    ? message.createReply()
+                    : message.createErrorReply(QDBusError::InternalError, QString()));
+    });
+}
+
+void CliDeviceLockSettings::changeSettings(
+        const QString &, const QVariant &authenticationToken, const QVariantMap &settings)
+{
+    if (settings.isEmpty()) {
+        return;
+    }
+
+    const QDBusMessage message = HostObject::message();
+    QDBusConnection connection = HostObject::connection();
+
+    HostObject::setDelayedReply(true);
+
+    QStringList keysAndValues;
+    for (auto it = settings.constBegin(); it != settings.constEnd(); ++it) {
+        keysAndValues << it.key() << it.value().toString();
+    }
+
+    const auto finished = [this, message, connection, keysAndValues](int result) mutable {
+        if (result == HostAuthenticationInput::Success) {
+            settingsWritten(keysAndValues);
+        }
+
+        sendMessage(connection.name(), result == HostAuthenticationInput::Success
+                    ? message.createReply()
+                    : message.createErrorReply(QDBusError::InternalError, QString()));
+    };
+
+    if (m_watcher->supportsMultipleConfigKeys()) {
+        m_watcher->invokePlugin(QStringList()
+                    << QStringLiteral("--set-config-key")
+                    << authenticationToken.toString()
+                    << keysAndValues)->onFinished(this, finished);
+    } else {
+        setConfigKeys(authenticationToken.toString(), keysAndValues, finished);
     }
 }
 
+// Applies settings one invocation at a time for plugins which only accept a single key, stopping
+// at the first failure.
+void CliDeviceLockSettings::setConfigKeys(
+        const QString &authenticationToken,
+        QStringList keysAndValues,
+        const std::function<void(int result)> &finished)
+{
+    const QString key = keysAndValues.takeFirst();
+    const QString value = keysAndValues.takeFirst();
+
+    m_watcher->invokePlugin(QStringList()
+                << QStringLiteral("--set-config-key")
+                << authenticationToken
+                << key
+                << value)->onFinished(this, [this, authenticationToken, keysAndValues, finished](int result) {
+        if (result != HostAuthenticationInput::Success || keysAndValues.isEmpty()) {
+            finished(result);
+        } else {
+            setConfigKeys(authenticationToken, keysAndValues, finished);
+        }
+    });
+}
+
 }
@@ -37,6 +37,8 @@
 
 #include <QSharedDataPointer>
 
+#include <functional>
+
 namespace NemoDeviceLock
 {
 
@@ -54,8 +56,17 @@ public:
             const QVariant &authenticationToken,
             const QString &key,
             const QVariant &value) override;
+    void changeSettings(
+            const QString &requestor,
+            const QVariant &authenticationToken,
+            const QVariantMap &settings) override;
 
 private:
+    inline void setConfigKeys(
+            const QString &authenticationToken,
+            QStringList keysAndValues,
+            const std::function<void(int result)> &finished);
+
     QExplicitlySharedDataPointer<LockCodeWatcher> m_watcher;
 };
 
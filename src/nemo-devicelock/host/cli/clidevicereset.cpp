@@ -64,9 +64,16 @@ void CliDeviceReset::clearDevice(
         arguments << QStringLiteral("--wipe");
     }
 
-    if (m_watcher->runPlugin(arguments) != HostAuthenticationInput::Success) {
-        QDBusContext::sendErrorReply(QDBusError::InternalError);
-    }
+    const QDBusMessage message = HostObject::message();
+    QDBusConnection connection = HostObject::connection();
+
+    HostObject::setDelayedReply(true);
+
+    m_watcher->invokePlugin(arguments)->onFinished(this, [this, message, connection](int result) mutable {
+        sendMessage(connection.name(), result == HostAuthenticationInput::Success
+                    ? message.createReply()
+                    : message.createErrorReply(QDBusError::InternalError, QString()));
+    });
 }
 
 }
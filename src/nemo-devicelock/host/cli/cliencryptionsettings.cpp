@@ -45,8 +45,13 @@ CliEncryptionSettings::CliEncryptionSettings(QObject *parent)
     : HostEncryptionSettings(Authenticator::SecurityCode, parent)
     , m_watcher(LockCodeWatcher::instance())
     , m_supported(false)
-    , m_supportChecked(false)
 {
+    // Support doesn't change while the daemon is running, ask once rather than blocking each
+    // property read on the plugin.
+    m_watcher->invokePlugin(QStringList()
+                << QStringLiteral("--is-encryption-supported"))->onFinished(this, [this](int result) {
+        m_supported = result == HostAuthenticationInput::Success;
+    });
 }
 
 CliEncryptionSettings::~CliEncryptionSettings()
@@ -55,21 +60,23 @@ CliEncryptionSettings::~CliEncryptionSettings()
 
 bool CliEncryptionSettings::isSupported() const
 {
-    if (!m_supportChecked) {
-        m_supportChecked = true;
-        m_supported = m_watcher->runPlugin(QStringList()
-                    << QStringLiteral("--is-encryption-supported")) == HostAuthenticationInput::Success;
-    }
     return m_supported;
 }
 
 void CliEncryptionSettings::encryptHome(const QString &, const QVariant &authenticationToken)
 {
-    if (m_watcher->runPlugin(QStringList()
+    const QDBusMessage message = HostObject::message();
+    QDBusConnection connection = HostObject::connection();
+
+    HostObject::setDelayedReply(true);
+
+    m_watcher->invokePlugin(QStringList()
                 << QStringLiteral("--encrypt-home")
-                << authenticationToken.toString()) != HostAuthenticationInput::Success) {
-        QDBusContext::sendErrorReply(QDBusError::InternalError);
-    }
+                << authenticationToken.toString())->onFinished(this, [this, message, connection](int result) mutable {
+        sendMessage(connection.name(), result == HostAuthenticationInput::Success
+                    ? message.createReply()
+                    : message.createErrorReply(QDBusError::InternalError, QString()));
+    });
 }
 
 }
@@ -53,8 +53,7 @@ public:
 
 private:
     QExplicitlySharedDataPointer<LockCodeWatcher> m_watcher;
-    mutable bool m_supported;
-    mutable bool m_supportChecked;
+    bool m_supported;
 };
 
 }
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef NEMODEVICELOCK_CLIPLUGIN_H
+#define NEMODEVICELOCK_CLIPLUGIN_H
+
+/*
+ * Entry points of an in-process device lock plugin.
+ *
+ * If the pluginName in devicelock.conf names a shared library rather than an executable the
+ * daemon loads it and calls these functions in place of invoking the executable with the
+ * equivalent command line.  Each function returns the exit code the executable would have
+ * returned for the same request, 0 for success.  Any entry point which isn't exported by the
+ * library fails its request.
+ *
+ * The functions are called from a pool of worker threads.  Unless the library exports
+ * nemo_devicelock_is_reentrant() and it returns non-zero only one call is made at a time.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    NEMO_DEVICELOCK_CLEAR_DEVICE_REBOOT = 0x01, /* --reboot */
+    NEMO_DEVICELOCK_CLEAR_DEVICE_WIPE   = 0x02  /* --wipe */
+};
+
+/* --check-code <code> */
+int nemo_devicelock_check_code(const char *code);
+/* --set-code <old code> <new code> */
+int nemo_devicelock_set_code(const char *old_code, const char *new_code);
+/* --clear-code <code> */
+int nemo_devicelock_clear_code(const char *code);
+/* --unlock <code> */
+int nemo_devicelock_unlock(const char *code);
+/* --is-set <key> */
+int nemo_devicelock_is_set(const char *key);
+/* --set-config-key <token> <key> <value> */
+int nemo_devicelock_set_config_key(const char *token, const char *key, const char *value);
+/* --set-config-key <token> <key> <value> [<key> <value>...], optional.  If it isn't exported
+   nemo_devicelock_set_config_key() is called for each key in turn. */
+int nemo_devicelock_set_config_keys(
+        const char *token, const char * const *keys, const char * const *values, int count);
+/* --clear-device <token> [--reboot] [--wipe] */
+int nemo_devicelock_clear_device(const char *token, int options);
+/* --is-encryption-supported */
+int nemo_devicelock_is_encryption_supported(void);
+/* --encrypt-home <token> */
+int nemo_devicelock_encrypt_home(const char *token);
+
+/* Optional, non-zero if the other entry points may be called concurrently. */
+int nemo_devicelock_is_reentrant(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
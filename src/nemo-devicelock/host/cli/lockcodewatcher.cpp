@@ -33,6 +33,10 @@
 #include "lockcodewatcher.h"
 
 #include "cliauthenticator.h"
+#include "pluginlibrary.h"
+#include "pluginprocess.h"
+#include "pluginscheduler.h"
+#include "settingswatcher.h"
 
 #include <QDBusConnection>
 #include <QDBusMessage>
@@ -42,21 +46,42 @@
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QLibrary>
 #include <QProcess>
 #include <QSettings>
 #include <QStandardPaths>
+#include <QTimer>
 
 namespace NemoDeviceLock
 {
 
+// The configuration may be read from an alternative file, i.e. to benchmark the daemon with a fake
+// plugin.
+static QString configurationPath()
+{
+    static const QString path = []() {
+        const QByteArray path = qgetenv("NEMODEVICELOCK_CONFIG");
+        return !path.isEmpty()
+                ? QFile::decodeName(path)
+                : QStringLiteral("/usr/share/lipstick/devicelock/devicelock.conf");
+    }();
+
+    return path;
+}
+
+static QVariant configurationValue(const QString &key, const QVariant &defaultValue = QVariant())
+{
+    QSettings settings(configurationPath(), QSettings::IniFormat);
+    return settings.value(key, defaultValue);
+}
+
 static QString pluginName()
 {
     static const QString pluginName = []() {
-        QSettings settings(QStringLiteral("/usr/share/lipstick/devicelock/devicelock.conf"), QSettings::IniFormat);
-        const QString pluginName = settings.value(QStringLiteral("DeviceLock/pluginName")).toString();
+        const QString pluginName = configurationValue(QStringLiteral("DeviceLock/pluginName")).toString();
 
         if (pluginName.isEmpty()) {
-            qCWarning(daemon, "DeviceLock: no plugin configuration set in /usr/share/lipstick/devicelock/devicelock.conf");
+            qCWarning(daemon, "DeviceLock: no plugin configuration set in %s", qPrintable(configurationPath()));
         }
 
         return pluginName;
@@ -65,20 +90,234 @@ static QString pluginName()
     return pluginName;
 }
 
+static bool pluginPersistent()
+{
+    static const bool persistent = configurationValue(QStringLiteral("DeviceLock/persistent"), false).toBool();
+
+    return persistent;
+}
+
+// Whether a plugin executable which supports the --persistent protocol but isn't configured to
+// keep running should be started in anticipation of an unlock, and how long in milliseconds it
+// is kept running once it's no longer in use.
+static bool pluginPrewarm()
+{
+    static const bool prewarm = configurationValue(QStringLiteral("DeviceLock/prewarm"), false).toBool();
+
+    return prewarm;
+}
+
+static int pluginPrewarmIdleTimeout()
+{
+    static const int timeout = configurationValue(QStringLiteral("DeviceLock/prewarmIdleTimeout"), 10000).toInt();
+
+    return timeout;
+}
+
+// Whether the plugin executable accepts more than one key and value pair in a --set-config-key
+// invocation.
+static bool pluginMultipleConfigKeys()
+{
+    static const bool multiple = configurationValue(QStringLiteral("DeviceLock/multipleConfigKeys"), false).toBool();
+
+    return multiple;
+}
+
+// The number of plugin invocations which may be in progress at once.  One is reserved for
+// unlocking and lock state queries, and device resets and home encryption run in an additional
+// slot of their own.
+static int pluginConcurrency()
+{
+    static const int concurrency = qMax(1, configurationValue(QStringLiteral("DeviceLock/maximumConcurrency"), 2).toInt());
+
+    return concurrency;
+}
+
+// The time in milliseconds a plugin invocation is given to complete before it's terminated, zero
+// for no deadline.  Deadlines may be set for individual verbs in the PluginTimeouts group of
+// devicelock.conf, i.e. check-code=10000.  Wiping or encrypting the device can legitimately take
+// a long time and are exempt unless configured otherwise.
+static int pluginTimeout(const QString &verb)
+{
+    static QHash<QString, int> timeouts;
+
+    const auto it = timeouts.constFind(verb);
+    if (it != timeouts.constEnd()) {
+        return it.value();
+    }
+
+    const QString name = verb.mid(2);
+    const int defaultTimeout = name == QLatin1String("clear-device") || name == QLatin1String("encrypt-home")
+            ? 0
+            : configurationValue(QStringLiteral("PluginTimeouts/default"), 30000).toInt();
+    const int timeout = qMax(0, configurationValue(QStringLiteral("PluginTimeouts/") + name, defaultTimeout).toInt());
+
+    timeouts.insert(verb, timeout);
+
+    return timeout;
+}
+
+// The time in milliseconds a plugin is given to exit after being sent SIGTERM before it's killed.
+static int pluginKillDelay()
+{
+    static const int delay = configurationValue(QStringLiteral("PluginTimeouts/killDelay"), 1000).toInt();
+
+    return delay;
+}
+
+static void terminateProcess(QProcess *process)
+{
+    const qint64 pid = process->processId();
+
+    process->terminate();
+
+    QTimer::singleShot(pluginKillDelay(), process, [process, pid]() {
+        if (process->state() != QProcess::NotRunning) {
+            qCWarning(daemon, "DeviceLock: plugin %lli didn't exit after SIGTERM, killing it", pid);
+
+            process->kill();
+        }
+    });
+}
+
+// The plugin's exit codes for the results it can report, anything else is a failure.  An exit code
+// must never be mistaken for one of the daemon's own results such as Evaluating.
+static int pluginResult(int exitCode)
+{
+    return exitCode >= 0 && exitCode <= -HostAuthenticationInput::LockedOut
+            ? -exitCode
+            : HostAuthenticationInput::Failure;
+}
+
+// Only code checks are passed to a pre-warmed process, it's started in anticipation of one.
+static bool isWarmVerb(const QString &verb)
+{
+    return verb == QLatin1String("--check-code") || verb == QLatin1String("--unlock");
+}
+
+static PluginScheduler::Priority pluginPriority(const QString &verb)
+{
+    if (verb == QLatin1String("--unlock") || verb == QLatin1String("--is-set")) {
+        return PluginScheduler::LockStatePriority;
+    } else if (verb == QLatin1String("--check-code")
+               || verb == QLatin1String("--set-code")
+               || verb == QLatin1String("--clear-code")) {
+        return PluginScheduler::AuthenticationPriority;
+    } else if (verb == QLatin1String("--clear-device")
+               || verb == QLatin1String("--encrypt-home")) {
+        return PluginScheduler::MaintenancePriority;
+    } else {
+        return PluginScheduler::SettingsPriority;
+    }
+}
+
+// Results of queries which only change when the plugin applies a change or the settings file is
+// modified are cached, and the cache is persisted to survive a restart of the daemon.  Writes are
+// batched so a burst of queries is saved once and the file I/O stays out of the query path.
+static const int cacheSaveDelay = 1000;
+
+// An instance with an alternative configuration keeps its cache alongside that configuration.
+static QString cachePath()
+{
+    static const QString path = qEnvironmentVariableIsEmpty("NEMODEVICELOCK_CONFIG")
+            ? QStringLiteral("/run/nemo-devicelock/plugin-cache.conf")
+            : QFileInfo(configurationPath()).dir().filePath(QStringLiteral("plugin-cache.conf"));
+
+    return path;
+}
+
+static const auto settingsPath = QStringLiteral("/usr/share/lipstick/devicelock/devicelock_settings.conf");
+static const auto isSetQuery = QStringLiteral("--is-set lockcode");
+
+static bool isCachedQuery(const QString &verb)
+{
+    return verb == QLatin1String("--is-set")
+            || verb == QLatin1String("--is-encryption-supported");
+}
+
+static bool invalidatesCache(const QString &verb)
+{
+    return verb == QLatin1String("--set-code")
+            || verb == QLatin1String("--clear-code")
+            || verb == QLatin1String("--set-config-key")
+            || verb == QLatin1String("--clear-device")
+            || verb == QLatin1String("--encrypt-home");
+}
+
+// A persisted cache is only valid if neither the plugin nor the settings have been modified since
+// it was written.
+static QString cacheStamp()
+{
+    return QStringLiteral("%1:%2").arg(
+                QString::number(QFileInfo(pluginName()).lastModified().toMSecsSinceEpoch()),
+                QString::number(QFileInfo(settingsPath).lastModified().toMSecsSinceEpoch()));
+}
+
 LockCodeWatcher *LockCodeWatcher::sharedInstance = nullptr;
 
 LockCodeWatcher::LockCodeWatcher(QObject *parent)
     : QObject(parent)
+    , m_settings(SettingsWatcher::instance())
     , m_pluginExists(QFile::exists(pluginName()))
-    , m_securityCodeSet(false)
-    , m_codeSetInvalidated(true)
+    , m_pluginLibrary(m_pluginExists && QLibrary::isLibrary(pluginName())
+            ? new PluginLibrary(pluginName(), this)
+            : nullptr)
+    , m_pluginProcess(m_pluginExists && !m_pluginLibrary && (pluginPersistent() || pluginPrewarm())
+            ? new PluginProcess(pluginName(), pluginPersistent(), this)
+            : nullptr)
+    // A persistent process answers requests in order and a library which isn't reentrant can
+    // only make one call at a time, so only one request is passed to them at a time and the
+    // queue decides which goes next.
+    , m_scheduler(new PluginScheduler(
+                (m_pluginProcess && pluginPersistent())
+                        || (m_pluginLibrary && !m_pluginLibrary->isReentrant())
+                    ? 1
+                    : pluginConcurrency(),
+                this))
+    , m_cacheHits(0)
+    , m_cacheMisses(0)
+    , m_cacheGeneration(0)
+    , m_timeouts(0)
+    , m_prewarmCount(0)
+    , m_prewarmUsed(0)
+    , m_warmInvocations(0)
+    , m_warmUsed(false)
+    , m_securityCodeSet(true)
 {
     Q_ASSERT(!sharedInstance);
     sharedInstance = this;
+
+    m_settingsState = m_settings->state();
+
+    connect(m_settings.data(), &SettingsWatcher::stateChanged, this, &LockCodeWatcher::settingsStateChanged);
+
+    if (m_pluginLibrary) {
+        m_pluginLibrary->setMaximumThreadCount(m_scheduler->maximumActive());
+    }
+
+    m_idleTimer.setSingleShot(true);
+    m_idleTimer.setInterval(pluginPrewarmIdleTimeout());
+    connect(&m_idleTimer, &QTimer::timeout, this, &LockCodeWatcher::discardIdleProcess);
+
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(cacheSaveDelay);
+    connect(&m_saveTimer, &QTimer::timeout, this, [this]() {
+        saveCache();
+    });
+
+    loadCache();
+
+    // Until the plugin has answered the security code is assumed to be set, so nothing is left
+    // unlocked while the daemon starts.  A persisted answer is applied immediately.
+    refreshSecurityCodeSet();
 }
 
 LockCodeWatcher::~LockCodeWatcher()
 {
+    if (m_saveTimer.isActive()) {
+        saveCache();
+    }
+
     sharedInstance = nullptr;
 }
 
@@ -89,45 +328,520 @@ LockCodeWatcher *LockCodeWatcher::instance()
 
 bool LockCodeWatcher::securityCodeSet() const
 {
-    if (m_codeSetInvalidated) {
-        m_codeSetInvalidated = false;
-        m_securityCodeSet = runPlugin(QStringList()
-                    << QStringLiteral("--is-set")
-                    << QStringLiteral("lockcode")) == HostAuthenticationInput::Success;
-    }
     return m_securityCodeSet;
 }
 
 void LockCodeWatcher::invalidateSecurityCodeSet()
 {
-    if (!m_codeSetInvalidated) {
-        m_codeSetInvalidated = true;
+    invalidateCache();
+}
 
-        emit securityCodeSetChanged();
+PluginCall *LockCodeWatcher::invokePlugin(const QStringList &arguments) const
+{
+    const QString verb = arguments.value(0);
+
+    PluginCall * const call = new PluginCall(verb, const_cast<LockCodeWatcher *>(this));
+
+    if (isCachedQuery(verb)) {
+        const QString key = arguments.join(QLatin1Char(' '));
+        const auto it = m_cache.constFind(key);
+
+        if (it != m_cache.constEnd()) {
+            ++m_cacheHits;
+
+            qCDebug(daemon, "DeviceLock: plugin cache hit for %s (%i hits, %i misses)",
+                        qPrintable(key), m_cacheHits, m_cacheMisses);
+
+            call->completed(-it.value());
+            return call;
+        }
+
+        ++m_cacheMisses;
+
+        qCDebug(daemon, "DeviceLock: plugin cache miss for %s (%i hits, %i misses)",
+                    qPrintable(key), m_cacheHits, m_cacheMisses);
+
+        const int generation = m_cacheGeneration;
+        connect(call, &PluginCall::finished, this, [this, call, key, generation](int result) {
+            // Don't cache a failure to run the plugin, or a result which may have been made
+            // stale by a change applied while the query was in progress.
+            if (call->m_answered && generation == m_cacheGeneration) {
+                m_cache.insert(key, result);
+                const_cast<LockCodeWatcher *>(this)->m_saveTimer.start();
+            }
+        });
+    } else if (invalidatesCache(verb)) {
+        connect(call, &PluginCall::finished, this, [this, verb](int result) {
+            if (result == HostAuthenticationInput::Success) {
+                LockCodeWatcher * const watcher = const_cast<LockCodeWatcher *>(this);
+
+                // There's no need to ask the plugin whether a code is set after it was just
+                // changed or cleared.
+                if (verb == QLatin1String("--set-code")) {
+                    watcher->setSecurityCodeSet(true);
+                } else if (verb == QLatin1String("--clear-code")) {
+                    watcher->setSecurityCodeSet(false);
+                }
+
+                watcher->invalidateCache();
+            }
+        });
+    }
+
+    connect(call, &PluginCall::finished, this, [this, call, verb]() {
+        recordStatistics(verb, call);
+    });
+
+    m_scheduler->schedule(call, pluginPriority(verb), [this, arguments](PluginCall *call) {
+        startPlugin(arguments, call);
+    });
+
+    return call;
+}
+
+// A library plugin always accepts multiple keys, and applies them one at a time if it has no
+// entry point to apply them all at once.
+bool LockCodeWatcher::supportsMultipleConfigKeys() const
+{
+    return m_pluginLibrary || pluginMultipleConfigKeys();
+}
+
+// Starts the plugin process ahead of an anticipated unlock so the security code can be checked
+// without waiting for the plugin to start.
+void LockCodeWatcher::prewarm()
+{
+    if (!m_pluginProcess || pluginPersistent()) {
+        return;
+    }
+
+    m_idleTimer.start();
+
+    if (!m_pluginProcess->isRunning() && m_pluginProcess->start()) {
+        ++m_prewarmCount;
+        m_warmUsed = false;
+
+        qCDebug(daemon, "DeviceLock: pre-warmed plugin process (%i of %i used)",
+                    m_prewarmUsed, m_prewarmCount);
+    }
+}
+
+int LockCodeWatcher::prewarmCount() const
+{
+    return m_prewarmCount;
+}
+
+int LockCodeWatcher::prewarmUsedCount() const
+{
+    return m_prewarmUsed;
+}
+
+int LockCodeWatcher::warmInvocations() const
+{
+    return m_warmInvocations;
+}
+
+int LockCodeWatcher::cacheHits() const
+{
+    return m_cacheHits;
+}
+
+int LockCodeWatcher::cacheMisses() const
+{
+    return m_cacheMisses;
+}
+
+int LockCodeWatcher::timeouts() const
+{
+    return m_timeouts;
+}
+
+// Durations are in microseconds, results are keyed by the plugin's exit code or why there wasn't
+// one.
+QVariantMap LockCodeWatcher::statistics() const
+{
+    QVariantMap verbs;
+    for (auto it = m_statistics.constBegin(); it != m_statistics.constEnd(); ++it) {
+        QVariantMap results;
+        for (auto result = it->results.constBegin(); result != it->results.constEnd(); ++result) {
+            results.insert(result.key(), result.value());
+        }
+
+        verbs.insert(it.key(), QVariantMap {
+            { QStringLiteral("latency"), it->latency.toMap() },
+            { QStringLiteral("results"), results }
+        });
     }
+
+    return {
+        { QStringLiteral("verbs"), verbs },
+        { QStringLiteral("cacheHits"), m_cacheHits },
+        { QStringLiteral("cacheMisses"), m_cacheMisses },
+        { QStringLiteral("timeouts"), m_timeouts },
+        { QStringLiteral("prewarmed"), m_prewarmCount },
+        { QStringLiteral("prewarmedUsed"), m_prewarmUsed },
+        { QStringLiteral("warmInvocations"), m_warmInvocations },
+        { QStringLiteral("active"), m_scheduler->activeCount() },
+        { QStringLiteral("queued"), m_scheduler->queuedCount() }
+    };
 }
 
-int LockCodeWatcher::runPlugin(const QStringList &arguments) const
+void LockCodeWatcher::startPlugin(const QStringList &arguments, PluginCall *call) const
 {
     if (!m_pluginExists) {
-        return HostAuthenticationInput::Failure;
+        QTimer::singleShot(0, call, [call]() {
+            call->failed();
+        });
+        return;
     }
 
-    QProcess process;
-    process.start(pluginName(), arguments);
-    process.waitForFinished(-1);
+    call->m_elapsed.start();
 
-    return process.exitStatus() == QProcess::NormalExit
-            ? -process.exitCode()
-            : HostAuthenticationInput::Failure;
+    const int timeout = pluginTimeout(arguments.value(0));
+    if (timeout > 0) {
+        call->m_timeout = timeout;
+
+        QTimer::singleShot(timeout, call, [call]() {
+            call->timedOut();
+        });
+    }
+
+    if (m_pluginLibrary) {
+        call->m_threaded = true;
+        m_pluginLibrary->start(arguments, call);
+        return;
+    }
+
+    if (m_pluginProcess && pluginPersistent()) {
+        if (m_pluginProcess->invoke(arguments, call)) {
+            return;
+        }
+        qCWarning(daemon, "DeviceLock: falling back to a one-shot plugin invocation");
+    } else if (m_pluginProcess
+               && isWarmVerb(arguments.value(0))
+               && m_pluginProcess->isRunning()
+               && m_pluginProcess->isIdle()
+               && m_pluginProcess->invoke(arguments, call)) {
+        // A pre-warmed process takes one request at a time so a code check never waits behind
+        // another request, and abandoning a request affects no other.  It's kept for as long as
+        // it's in use.
+        LockCodeWatcher * const watcher = const_cast<LockCodeWatcher *>(this);
+        watcher->m_idleTimer.start();
+        watcher->m_warmUsed = true;
+        ++watcher->m_warmInvocations;
+        return;
+    }
+
+    QProcess * const process = new QProcess(call);
+    call->m_process = process;
+
+    connect(process, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+            call, [call](int exitCode, QProcess::ExitStatus exitStatus) {
+        if (exitStatus == QProcess::NormalExit) {
+            call->exited(exitCode);
+        } else {
+            call->failed();
+        }
+    });
+    // A failure to start may be reported from within start(), queue it so there's an opportunity
+    // to connect to the call first.
+    connect(process, &QProcess::errorOccurred, call, [call](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart) {
+            call->failed();
+        }
+    }, Qt::QueuedConnection);
+
+    process->start(pluginName(), arguments);
+}
+
+// The settings file is rewritten by the plugin for every failed attempt, only a change to the
+// settings describing the code or encryption can change the answers to the cached queries.
+void LockCodeWatcher::settingsStateChanged()
+{
+    const QExplicitlySharedDataPointer<const SettingsState> state = m_settings->state();
+    const SettingsState::Fields fields = state->changedFields(*m_settingsState);
+
+    m_settingsState = state;
+
+    if (fields & (SettingsState::CurrentLength
+                | SettingsState::CurrentCodeIsDigitOnly
+                | SettingsState::IsHomeEncrypted)) {
+        invalidateCache();
+    }
 }
 
-void LockCodeWatcher::securityCodeSetInvalidated()
+void LockCodeWatcher::refreshSecurityCodeSet()
 {
-    if (!m_codeSetInvalidated) {
-        m_codeSetInvalidated = true;
+    // A query which is already in progress is repeated once it finishes if the cache was
+    // invalidated in the meantime.
+    if (m_securityCodeSetQuery) {
+        return;
+    }
+
+    const auto it = m_cache.constFind(isSetQuery);
+    if (it != m_cache.constEnd()) {
+        ++m_cacheHits;
+
+        setSecurityCodeSet(it.value() == HostAuthenticationInput::Success);
+        return;
+    }
+
+    const int generation = m_cacheGeneration;
+
+    PluginCall * const call = invokePlugin(QStringList()
+                << QStringLiteral("--is-set")
+                << QStringLiteral("lockcode"));
+    m_securityCodeSetQuery = call;
+
+    call->onFinished(this, [this, call, generation](int result) {
+        m_securityCodeSetQuery = nullptr;
+
+        if (generation != m_cacheGeneration) {
+            refreshSecurityCodeSet();
+        } else if (call->m_answered || !m_pluginExists) {
+            // Keep the last known state if the plugin failed to answer.
+            setSecurityCodeSet(result == HostAuthenticationInput::Success);
+        }
+    });
+}
+
+void LockCodeWatcher::setSecurityCodeSet(bool set)
+{
+    if (m_securityCodeSet != set) {
+        m_securityCodeSet = set;
+
         emit securityCodeSetChanged();
     }
 }
 
+void LockCodeWatcher::discardIdleProcess()
+{
+    if (!m_pluginProcess->isIdle()) {
+        m_idleTimer.start();
+        return;
+    }
+
+    if (m_warmUsed) {
+        ++m_prewarmUsed;
+    }
+
+    qCDebug(daemon, "DeviceLock: discarding idle plugin process (%i of %i pre-warmed processes used, %i invocations)",
+                m_prewarmUsed, m_prewarmCount, m_warmInvocations);
+
+    m_pluginProcess->stop(pluginKillDelay());
+}
+
+void LockCodeWatcher::recordStatistics(const QString &verb, PluginCall *call) const
+{
+    VerbStatistics &statistics = m_statistics[verb];
+
+    // A call canceled before it started never ran the plugin.
+    if (call->m_elapsed.isValid()) {
+        statistics.latency.record(call->m_elapsed.nsecsElapsed() / 1000);
+    }
+
+    QString result;
+    if (call->m_answered) {
+        result = QString::number(call->m_exitCode);
+    } else if (call->m_timedOut) {
+        result = QStringLiteral("timedOut");
+    } else {
+        result = QStringLiteral("failed");
+    }
+    ++statistics.results[result];
+}
+
+void LockCodeWatcher::loadCache()
+{
+    QSettings cache(cachePath(), QSettings::IniFormat);
+
+    if (cache.value(QStringLiteral("stamp")).toString() != cacheStamp()) {
+        return;
+    }
+
+    const int count = cache.beginReadArray(QStringLiteral("results"));
+    for (int i = 0; i < count; ++i) {
+        cache.setArrayIndex(i);
+        m_cache.insert(
+                    cache.value(QStringLiteral("query")).toString(),
+                    cache.value(QStringLiteral("result")).toInt());
+    }
+    cache.endArray();
+}
+
+void LockCodeWatcher::saveCache() const
+{
+    QSettings cache(cachePath(), QSettings::IniFormat);
+    cache.clear();
+    cache.setValue(QStringLiteral("stamp"), cacheStamp());
+
+    cache.beginWriteArray(QStringLiteral("results"), m_cache.count());
+    int index = 0;
+    for (auto it = m_cache.constBegin(); it != m_cache.constEnd(); ++it) {
+        cache.setArrayIndex(index++);
+        cache.setValue(QStringLiteral("query"), it.key());
+        cache.setValue(QStringLiteral("result"), it.value());
+    }
+    cache.endArray();
+}
+
+void LockCodeWatcher::invalidateCache()
+{
+    ++m_cacheGeneration;
+
+    if (!m_cache.isEmpty()) {
+        m_cache.clear();
+        m_saveTimer.stop();
+        QFile::remove(cachePath());
+    }
+
+    refreshSecurityCodeSet();
+}
+
+PluginCall::PluginCall(const QString &verb, QObject *parent)
+    : QObject(parent)
+    , m_verb(verb)
+    , m_timeout(0)
+    , m_result(HostAuthenticationInput::Failure)
+    , m_exitCode(0)
+    , m_finished(false)
+    , m_threaded(false)
+    , m_answered(false)
+    , m_timedOut(false)
+{
+}
+
+PluginCall::~PluginCall()
+{
+}
+
+bool PluginCall::isFinished() const
+{
+    return m_finished;
+}
+
+int PluginCall::result() const
+{
+    return m_result;
+}
+
+// Abandons the call, the plugin process running it is terminated.
+void PluginCall::cancel()
+{
+    if (!m_finished) {
+        abandon();
+        finish(HostAuthenticationInput::Failure);
+    }
+}
+
+void PluginCall::exited(int exitCode)
+{
+    if (!m_finished) {
+        m_threaded = false;
+        m_answered = true;
+        m_exitCode = exitCode;
+
+        finish(pluginResult(exitCode));
+    } else if (m_threaded) {
+        // The worker thread has let go of a call which was abandoned.
+        m_threaded = false;
+
+        deleteLater();
+    }
+}
+
+void PluginCall::completed(int exitCode)
+{
+    // The result is available immediately, defer emitting it until there has been an
+    // opportunity to connect to the call.
+    if (!m_finished) {
+        m_finished = true;
+        m_answered = true;
+        m_exitCode = exitCode;
+        m_result = pluginResult(exitCode);
+
+        QTimer::singleShot(0, this, [this]() {
+            emit finished(m_result);
+
+            deleteLater();
+        });
+    }
+}
+
+void PluginCall::failed()
+{
+    if (!m_finished) {
+        finish(HostAuthenticationInput::Failure);
+    }
+}
+
+// The process running the call exited before answering through no fault of the call's own, it's
+// reported as timed out rather than failed so it isn't mistaken for an incorrect security code.
+void PluginCall::interrupted()
+{
+    if (!m_finished) {
+        finish(HostAuthenticationInput::TimedOut);
+    }
+}
+
+void PluginCall::timedOut()
+{
+    if (m_finished) {
+        return;
+    }
+
+    if (LockCodeWatcher * const watcher = qobject_cast<LockCodeWatcher *>(parent())) {
+        ++watcher->m_timeouts;
+
+        qCWarning(daemon, "DeviceLock: plugin %s didn't finish within %ims, abandoning it (%i timeouts)",
+                    qPrintable(m_verb), m_timeout, watcher->m_timeouts);
+    }
+
+    m_timedOut = true;
+
+    abandon();
+    finish(HostAuthenticationInput::TimedOut);
+}
+
+void PluginCall::abandon()
+{
+    if (m_threaded) {
+        // There's no interrupting a call into a library, the worker thread is left to return in
+        // its own time.
+        qCWarning(daemon, "DeviceLock: abandoning in-process plugin call %s, a worker thread remains blocked",
+                    qPrintable(m_verb));
+    } else if (m_pluginProcess) {
+        // A persistent plugin won't read the requests behind this one until it has answered it,
+        // so it's restarted rather than left to finish a request nobody is waiting for.  Only one
+        // request is passed to a persistent or pre-warmed process at a time so there are no
+        // others in flight, a later request falls back to a one-shot invocation until the
+        // restarted process is ready.
+        m_pluginProcess->terminate(pluginKillDelay());
+    } else if (!m_process || m_process->state() == QProcess::NotRunning) {
+        // The call was never started or there's nothing left to stop.
+    } else {
+        // Let the process outlive the call for long enough to escalate from SIGTERM to SIGKILL.
+        QProcess * const process = m_process;
+
+        process->disconnect(this);
+        process->setParent(parent());
+        connect(process, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+                process, &QObject::deleteLater);
+
+        terminateProcess(process);
+    }
+}
+
+void PluginCall::finish(int result)
+{
+    m_finished = true;
+    m_result = result;
+
+    emit finished(m_result);
+
+    // A call which is still referenced by a worker thread is deleted when that returns.
+    if (!m_threaded) {
+        deleteLater();
+    }
+}
+
 }
@@ -35,14 +35,75 @@
 
 #include <QObject>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QPointer>
 #include <QProcess>
 #include <QSharedData>
+#include <QTimer>
+#include <QVariantMap>
 #include <QVector>
 
+#include <nemo-devicelock/host/latencyhistogram.h>
+
 namespace NemoDeviceLock
 {
 
+class PluginLibrary;
+class PluginProcess;
+class PluginScheduler;
+class SettingsState;
+class SettingsWatcher;
+
+class PluginCall : public QObject
+{
+    Q_OBJECT
+public:
+    ~PluginCall();
+
+    bool isFinished() const;
+    int result() const;
+
+    void cancel();
+
+    template <typename Function> void onFinished(QObject *context, Function function)
+    {
+        connect(this, &PluginCall::finished, context, function);
+    }
+
+signals:
+    void finished(int result);
+
+private slots:
+    void exited(int exitCode);
+
+private:
+    friend class LockCodeWatcher;
+    friend class PluginProcess;
+
+    explicit PluginCall(const QString &verb, QObject *parent);
+
+    void failed();
+    void interrupted();
+    void completed(int exitCode);
+    void timedOut();
+
+    inline void abandon();
+    inline void finish(int result);
+
+    const QString m_verb;
+    QPointer<QProcess> m_process;
+    QPointer<PluginProcess> m_pluginProcess;
+    QElapsedTimer m_elapsed;
+    int m_timeout;
+    int m_result;
+    int m_exitCode;
+    bool m_finished;
+    bool m_threaded;
+    bool m_answered;
+    bool m_timedOut;
+};
+
 class LockCodeWatcher : public QObject, public QSharedData
 {
     Q_OBJECT
@@ -54,20 +115,71 @@ public:
     bool securityCodeSet() const;
     void invalidateSecurityCodeSet();
 
-    int runPlugin(const QStringList &arguments) const;
+    PluginCall *invokePlugin(const QStringList &arguments) const;
+
+    bool supportsMultipleConfigKeys() const;
+
+    void prewarm();
+
+    int prewarmCount() const;
+    int prewarmUsedCount() const;
+    int warmInvocations() const;
+
+    int cacheHits() const;
+    int cacheMisses() const;
+
+    int timeouts() const;
+
+    QVariantMap statistics() const;
 
 signals:
     void securityCodeSetChanged();
 
 private slots:
-    void securityCodeSetInvalidated();
+    void settingsStateChanged();
+    void discardIdleProcess();
 
 private:
+    friend class PluginCall;
+
     explicit LockCodeWatcher(QObject *parent = nullptr);
 
+    void startPlugin(const QStringList &arguments, PluginCall *call) const;
+
+    inline void refreshSecurityCodeSet();
+    inline void setSecurityCodeSet(bool set);
+
+    inline void loadCache();
+    inline void saveCache() const;
+    inline void invalidateCache();
+    inline void recordStatistics(const QString &verb, PluginCall *call) const;
+
+    struct VerbStatistics
+    {
+        LatencyHistogram latency;
+        QHash<QString, int> results;
+    };
+
+    QExplicitlySharedDataPointer<SettingsWatcher> m_settings;
+    QExplicitlySharedDataPointer<const SettingsState> m_settingsState;
     const bool m_pluginExists;
-    mutable bool m_securityCodeSet;
-    mutable bool m_codeSetInvalidated;
+    PluginLibrary * const m_pluginLibrary;
+    PluginProcess * const m_pluginProcess;
+    PluginScheduler * const m_scheduler;
+    mutable QHash<QString, VerbStatistics> m_statistics;
+    mutable QHash<QString, int> m_cache;
+    mutable int m_cacheHits;
+    mutable int m_cacheMisses;
+    int m_cacheGeneration;
+    int m_timeouts;
+    QTimer m_idleTimer;
+    QTimer m_saveTimer;
+    int m_prewarmCount;
+    int m_prewarmUsed;
+    int m_warmInvocations;
+    bool m_warmUsed;
+    bool m_securityCodeSet;
+    QPointer<PluginCall> m_securityCodeSetQuery;
 
     static LockCodeWatcher *sharedInstance;
 };
@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "pluginlibrary.h"
+
+#include "cliplugin.h"
+#include "lockcodewatcher.h"
+
+#include <nemo-devicelock/host/hostobject.h>
+
+#include <QRunnable>
+#include <QVector>
+
+namespace NemoDeviceLock
+{
+
+// The exit code of a request the plugin can't handle.
+static const int unsupportedExitCode = 1;
+
+template <typename Function> static void resolve(QLibrary *library, const char *symbol, Function *function)
+{
+    *function = reinterpret_cast<Function>(library->resolve(symbol));
+
+    if (library->isLoaded() && !*function) {
+        qCWarning(daemon, "DeviceLock: plugin %s doesn't implement %s",
+                    qPrintable(library->fileName()), symbol);
+    }
+}
+
+class PluginLibraryTask : public QRunnable
+{
+public:
+    PluginLibraryTask(PluginLibrary *library, const QStringList &arguments, PluginCall *call)
+        : m_library(library)
+        , m_arguments(arguments)
+        , m_call(call)
+    {
+    }
+
+    void run() override
+    {
+        const int exitCode = m_library->invoke(m_arguments);
+
+        // The call is owned by the main thread and won't finish until it receives the result.
+        QMetaObject::invokeMethod(m_call, "exited", Qt::QueuedConnection, Q_ARG(int, exitCode));
+    }
+
+private:
+    PluginLibrary * const m_library;
+    const QStringList m_arguments;
+    PluginCall * const m_call;
+};
+
+PluginLibrary::PluginLibrary(const QString &fileName, QObject *parent)
+    : QObject(parent)
+    , m_library(fileName)
+    , m_reentrant(false)
+{
+    if (!m_library.load()) {
+        qCWarning(daemon, "DeviceLock: failed to load plugin %s: %s",
+                    qPrintable(fileName), qPrintable(m_library.errorString()));
+    }
+
+    resolve(&m_library, "nemo_devicelock_check_code", &m_checkCode);
+    resolve(&m_library, "nemo_devicelock_set_code", &m_setCode);
+    resolve(&m_library, "nemo_devicelock_clear_code", &m_clearCode);
+    resolve(&m_library, "nemo_devicelock_unlock", &m_unlock);
+    resolve(&m_library, "nemo_devicelock_is_set", &m_isSet);
+    resolve(&m_library, "nemo_devicelock_set_config_key", &m_setConfigKey);
+    m_setConfigKeys = reinterpret_cast<decltype(m_setConfigKeys)>(
+                m_library.resolve("nemo_devicelock_set_config_keys"));
+    resolve(&m_library, "nemo_devicelock_clear_device", &m_clearDevice);
+    resolve(&m_library, "nemo_devicelock_is_encryption_supported", &m_isEncryptionSupported);
+    resolve(&m_library, "nemo_devicelock_encrypt_home", &m_encryptHome);
+
+    if (const auto isReentrant = reinterpret_cast<int (*)()>(
+                m_library.resolve("nemo_devicelock_is_reentrant"))) {
+        m_reentrant = isReentrant() != 0;
+    }
+
+    // Keep the worker threads for the life of the daemon, a plugin may keep thread local state.
+    m_threadPool.setExpiryTimeout(-1);
+}
+
+PluginLibrary::~PluginLibrary()
+{
+    // Keep the library loaded until the process exits, plugins aren't required to clean up
+    // after themselves.
+}
+
+bool PluginLibrary::isLoaded() const
+{
+    return m_library.isLoaded();
+}
+
+bool PluginLibrary::isReentrant() const
+{
+    return m_reentrant;
+}
+
+void PluginLibrary::setMaximumThreadCount(int count)
+{
+    m_threadPool.setMaxThreadCount(count);
+}
+
+void PluginLibrary::start(const QStringList &arguments, PluginCall *call)
+{
+    m_threadPool.start(new PluginLibraryTask(this, arguments, call));
+}
+
+int PluginLibrary::invoke(const QStringList &arguments)
+{
+    QMutexLocker locker(m_reentrant ? nullptr : &m_mutex);
+
+    const QString verb = arguments.value(0);
+    const QByteArray argument1 = arguments.value(1).toUtf8();
+    const QByteArray argument2 = arguments.value(2).toUtf8();
+    const QByteArray argument3 = arguments.value(3).toUtf8();
+
+    if (verb == QLatin1String("--check-code") && m_checkCode) {
+        return m_checkCode(argument1.constData());
+    } else if (verb == QLatin1String("--set-code") && m_setCode) {
+        return m_setCode(argument1.constData(), argument2.constData());
+    } else if (verb == QLatin1String("--clear-code") && m_clearCode) {
+        return m_clearCode(argument1.constData());
+    } else if (verb == QLatin1String("--unlock") && m_unlock) {
+        return m_unlock(argument1.constData());
+    } else if (verb == QLatin1String("--is-set") && m_isSet) {
+        return m_isSet(argument1.constData());
+    } else if (verb == QLatin1String("--set-config-key") && arguments.count() > 4) {
+        return setConfigKeys(arguments);
+    } else if (verb == QLatin1String("--set-config-key") && m_setConfigKey) {
+        return m_setConfigKey(argument1.constData(), argument2.constData(), argument3.constData());
+    } else if (verb == QLatin1String("--clear-device") && m_clearDevice) {
+        int options = 0;
+        if (arguments.contains(QStringLiteral("--reboot"))) {
+            options |= NEMO_DEVICELOCK_CLEAR_DEVICE_REBOOT;
+        }
+        if (arguments.contains(QStringLiteral("--wipe"))) {
+            options |= NEMO_DEVICELOCK_CLEAR_DEVICE_WIPE;
+        }
+        return m_clearDevice(argument1.constData(), options);
+    } else if (verb == QLatin1String("--is-encryption-supported") && m_isEncryptionSupported) {
+        return m_isEncryptionSupported();
+    } else if (verb == QLatin1String("--encrypt-home") && m_encryptHome) {
+        return m_encryptHome(argument1.constData());
+    } else {
+        return unsupportedExitCode;
+    }
+}
+
+int PluginLibrary::setConfigKeys(const QStringList &arguments)
+{
+    const QByteArray token = arguments.value(1).toUtf8();
+
+    QVector<QByteArray> data;
+    QVector<const char *> keys;
+    QVector<const char *> values;
+    for (int i = 2; i + 1 < arguments.count(); i += 2) {
+        data.append(arguments.at(i).toUtf8());
+        data.append(arguments.at(i + 1).toUtf8());
+    }
+    for (int i = 0; i < data.count(); i += 2) {
+        keys.append(data.at(i).constData());
+        values.append(data.at(i + 1).constData());
+    }
+
+    if (m_setConfigKeys) {
+        return m_setConfigKeys(token.constData(), keys.constData(), values.constData(), keys.count());
+    } else if (m_setConfigKey) {
+        for (int i = 0; i < keys.count(); ++i) {
+            if (const int exitCode = m_setConfigKey(token.constData(), keys.at(i), values.at(i))) {
+                return exitCode;
+            }
+        }
+        return 0;
+    } else {
+        return unsupportedExitCode;
+    }
+}
+
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef NEMODEVICELOCK_PLUGINLIBRARY_H
+#define NEMODEVICELOCK_PLUGINLIBRARY_H
+
+#include <QLibrary>
+#include <QMutex>
+#include <QStringList>
+#include <QThreadPool>
+
+namespace NemoDeviceLock
+{
+
+class PluginCall;
+
+// An in-process device lock plugin implementing the entry points declared in cliplugin.h.
+class PluginLibrary : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PluginLibrary(const QString &fileName, QObject *parent = nullptr);
+    ~PluginLibrary();
+
+    bool isLoaded() const;
+    bool isReentrant() const;
+
+    void setMaximumThreadCount(int count);
+
+    int invoke(const QStringList &arguments);
+    void start(const QStringList &arguments, PluginCall *call);
+
+private:
+    inline int setConfigKeys(const QStringList &arguments);
+
+    QLibrary m_library;
+    QThreadPool m_threadPool;
+    QMutex m_mutex;
+    bool m_reentrant;
+
+    int (*m_checkCode)(const char *code);
+    int (*m_setCode)(const char *oldCode, const char *newCode);
+    int (*m_clearCode)(const char *code);
+    int (*m_unlock)(const char *code);
+    int (*m_isSet)(const char *key);
+    int (*m_setConfigKey)(const char *token, const char *key, const char *value);
+    int (*m_setConfigKeys)(const char *token, const char * const *keys, const char * const *values, int count);
+    int (*m_clearDevice)(const char *token, int options);
+    int (*m_isEncryptionSupported)();
+    int (*m_encryptHome)(const char *token);
+};
+
+}
+
+#endif
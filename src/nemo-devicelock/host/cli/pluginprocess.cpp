@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "pluginprocess.h"
+
+#include "lockcodewatcher.h"
+
+#include <nemo-devicelock/host/hostobject.h>
+
+#include <QTimer>
+
+namespace NemoDeviceLock
+{
+
+// Restarting a plugin which crashes on start up would just spin, give up after a few attempts
+// and let requests fall back to one-shot invocations.
+static const int maximumRestarts = 3;
+
+static void appendUint32(QByteArray *frame, quint32 value)
+{
+    frame->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+PluginProcess::PluginProcess(const QString &program, bool keepRunning, QObject *parent)
+    : QObject(parent)
+    , m_program(program)
+    , m_restarts(0)
+    , m_keepRunning(keepRunning)
+    , m_stopping(false)
+    , m_terminating(false)
+{
+    m_process.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+
+    connect(&m_process, &QProcess::started, this, &PluginProcess::processStarted);
+    connect(&m_process, &QProcess::errorOccurred, this, &PluginProcess::processError);
+    connect(&m_process, &QProcess::readyReadStandardOutput, this, &PluginProcess::readResults);
+    connect(&m_process, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+            this, &PluginProcess::processFinished);
+}
+
+PluginProcess::~PluginProcess()
+{
+    if (m_process.state() != QProcess::NotRunning) {
+        m_stopping = true;
+
+        // The daemon is exiting, there's nothing left to block.
+        m_process.closeWriteChannel();
+        if (!m_process.waitForFinished(1000)) {
+            m_process.kill();
+            m_process.waitForFinished(-1);
+        }
+    }
+}
+
+// A process which is still starting counts as running, requests made to it are written once it
+// has started.
+bool PluginProcess::isRunning() const
+{
+    return m_process.state() != QProcess::NotRunning && !m_stopping && !m_terminating;
+}
+
+bool PluginProcess::isIdle() const
+{
+    return m_pending.isEmpty();
+}
+
+bool PluginProcess::start()
+{
+    if (m_restarts >= maximumRestarts || m_stopping || m_terminating) {
+        return false;
+    } else if (m_process.state() == QProcess::NotRunning) {
+        m_process.start(m_program, QStringList() << QStringLiteral("--persistent"));
+    }
+
+    return m_process.state() != QProcess::NotRunning;
+}
+
+void PluginProcess::processStarted()
+{
+    if (!m_unwritten.isEmpty()) {
+        m_process.write(m_unwritten);
+        m_unwritten.clear();
+    }
+}
+
+void PluginProcess::processError(QProcess::ProcessError error)
+{
+    if (error != QProcess::FailedToStart) {
+        return;
+    }
+
+    qCWarning(daemon, "DeviceLock: failed to start persistent plugin %s: %s",
+                qPrintable(m_program), qPrintable(m_process.errorString()));
+
+    // A program which can't be started won't start on a later attempt either, the requests
+    // which were waiting for it are interrupted and later ones fall back to one-shot invocations.
+    m_restarts = maximumRestarts;
+    m_unwritten.clear();
+
+    while (!m_pending.isEmpty()) {
+        if (PluginCall * const call = m_pending.dequeue()) {
+            call->interrupted();
+        }
+    }
+}
+
+void PluginProcess::stop(int killDelay)
+{
+    if (m_process.state() == QProcess::NotRunning || m_stopping || m_terminating) {
+        return;
+    }
+
+    m_stopping = true;
+
+    // Closing the write channel is the plugin's cue to exit.
+    m_process.closeWriteChannel();
+
+    killAfter(killDelay);
+}
+
+void PluginProcess::terminate(int killDelay)
+{
+    if (m_process.state() == QProcess::NotRunning || m_terminating) {
+        return;
+    }
+
+    m_terminating = true;
+
+    m_process.terminate();
+
+    killAfter(killDelay);
+}
+
+void PluginProcess::killAfter(int killDelay)
+{
+    const qint64 pid = m_process.processId();
+
+    QTimer::singleShot(killDelay, this, [this, pid]() {
+        if (m_process.state() != QProcess::NotRunning && m_process.processId() == pid) {
+            qCWarning(daemon, "DeviceLock: persistent plugin %lli didn't exit, killing it", pid);
+
+            m_process.kill();
+        }
+    });
+}
+
+bool PluginProcess::invoke(const QStringList &arguments, PluginCall *call)
+{
+    if (!start()) {
+        return false;
+    }
+
+    QByteArray frame;
+    appendUint32(&frame, arguments.count());
+    for (const QString &argument : arguments) {
+        const QByteArray data = argument.toUtf8();
+        appendUint32(&frame, data.size());
+        frame.append(data);
+    }
+
+    if (m_process.state() == QProcess::Running) {
+        m_process.write(frame);
+    } else {
+        m_unwritten.append(frame);
+    }
+
+    call->m_process = &m_process;
+    call->m_pluginProcess = this;
+
+    m_pending.enqueue(call);
+
+    return true;
+}
+
+void PluginProcess::readResults()
+{
+    while (!m_pending.isEmpty() && m_process.bytesAvailable() >= qint64(sizeof(qint32))) {
+        qint32 exitCode = 0;
+        m_process.read(reinterpret_cast<char *>(&exitCode), sizeof(exitCode));
+
+        m_restarts = 0;
+
+        if (PluginCall * const call = m_pending.dequeue()) {
+            call->exited(exitCode);
+        }
+    }
+}
+
+void PluginProcess::processFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    const bool stopped = m_stopping;
+    const bool terminated = m_terminating;
+
+    m_stopping = false;
+    m_terminating = false;
+
+    readResults();
+
+    // Discard any partial response.
+    m_process.readAll();
+    m_unwritten.clear();
+
+    // Requests which were in flight may have been partially applied so it isn't safe to repeat
+    // them, they're reported as interrupted instead.
+    while (!m_pending.isEmpty()) {
+        if (PluginCall * const call = m_pending.dequeue()) {
+            call->interrupted();
+        }
+    }
+
+    if (!m_keepRunning || stopped) {
+        // Only a persistent plugin is kept running, a pre-warmed process is started again when
+        // it's next anticipated.
+    } else if (terminated) {
+        m_process.start(m_program, QStringList() << QStringLiteral("--persistent"));
+    } else if (m_restarts < maximumRestarts) {
+        qCWarning(daemon, "DeviceLock: persistent plugin %s %s (%i), restarting",
+                    qPrintable(m_program),
+                    exitStatus == QProcess::CrashExit ? "crashed" : "exited",
+                    exitCode);
+
+        ++m_restarts;
+        m_process.start(m_program, QStringList() << QStringLiteral("--persistent"));
+    } else {
+        qCWarning(daemon, "DeviceLock: persistent plugin %s keeps failing, not restarting",
+                    qPrintable(m_program));
+    }
+}
+
+}
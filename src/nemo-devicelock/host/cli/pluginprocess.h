@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef NEMODEVICELOCK_PLUGINPROCESS_H
+#define NEMODEVICELOCK_PLUGINPROCESS_H
+
+#include <QPointer>
+#include <QProcess>
+#include <QQueue>
+#include <QStringList>
+
+namespace NemoDeviceLock
+{
+
+// A long running instance of the device lock plugin.
+//
+// The plugin is started once with the --persistent argument and then receives requests on its
+// standard input instead of through its command line.  A request is a native endian 32 bit
+// argument count followed by each argument as a native endian 32 bit byte length and its UTF-8
+// encoded bytes.  For each request the plugin writes a single native endian 32 bit integer to its
+// standard output containing the exit code the equivalent one-shot invocation would have returned.
+//
+// The process is started without waiting for it, requests made while it's starting are held
+// until it's running.  Requests are answered in the order they were written.  invoke() returns
+// false only if the
+// request couldn't be delivered, in which case the caller is free to retry it as a one-shot
+// invocation.  That includes the interval in which a process is being stopped or a process running
+// an abandoned request is being terminated.
+//
+// If the process exits unexpectedly it's restarted straight away when keepRunning is set and
+// otherwise on the next request.
+class PluginCall;
+
+class PluginProcess : public QObject
+{
+    Q_OBJECT
+public:
+    PluginProcess(const QString &program, bool keepRunning, QObject *parent = nullptr);
+    ~PluginProcess();
+
+    bool isRunning() const;
+    bool isIdle() const;
+
+    bool start();
+    void stop(int killDelay);
+    void terminate(int killDelay);
+
+    bool invoke(const QStringList &arguments, PluginCall *call);
+
+private:
+    inline void processStarted();
+    inline void processError(QProcess::ProcessError error);
+    inline void readResults();
+    inline void processFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    inline void killAfter(int killDelay);
+
+    QProcess m_process;
+    QQueue<QPointer<PluginCall>> m_pending;
+    QByteArray m_unwritten;
+    const QString m_program;
+    int m_restarts;
+    const bool m_keepRunning;
+    bool m_stopping;
+    bool m_terminating;
+};
+
+}
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "pluginscheduler.h"
+
+#include "lockcodewatcher.h"
+
+namespace NemoDeviceLock
+{
+
+PluginScheduler::PluginScheduler(int maximumActive, QObject *parent)
+    : QObject(parent)
+    , m_maximumActive(qMax(1, maximumActive))
+    , m_active(0)
+    , m_maintenanceActive(0)
+{
+}
+
+PluginScheduler::~PluginScheduler()
+{
+}
+
+int PluginScheduler::maximumActive() const
+{
+    return hasOwnSlot(MaintenancePriority) ? m_maximumActive + 1 : m_maximumActive;
+}
+
+int PluginScheduler::activeCount() const
+{
+    return m_active + m_maintenanceActive;
+}
+
+int PluginScheduler::queuedCount() const
+{
+    int count = 0;
+    for (const auto &queue : m_queues) {
+        count += queue.count();
+    }
+    return count;
+}
+
+void PluginScheduler::schedule(
+        PluginCall *call, Priority priority, const std::function<void(PluginCall *call)> &start)
+{
+    m_queues[priority].enqueue({ call, start });
+
+    dispatch();
+}
+
+bool PluginScheduler::hasOwnSlot(Priority priority) const
+{
+    return priority == MaintenancePriority && m_maximumActive > 1;
+}
+
+bool PluginScheduler::canStart(Priority priority) const
+{
+    if (hasOwnSlot(priority)) {
+        return m_maintenanceActive == 0;
+    }
+
+    return m_active < m_maximumActive
+            && (priority == LockStatePriority || m_maximumActive == 1 || m_active < m_maximumActive - 1);
+}
+
+void PluginScheduler::dispatch()
+{
+    bool blocked = false;
+
+    for (int priority = 0; priority < PriorityCount; ++priority) {
+        const bool ownSlot = hasOwnSlot(Priority(priority));
+
+        // Don't let lower priority invocations overtake a queued one, unless they don't compete
+        // for the same slots.
+        if (blocked && !ownSlot) {
+            continue;
+        }
+
+        QQueue<Task> &queue = m_queues[priority];
+        int &active = ownSlot ? m_maintenanceActive : m_active;
+
+        while (!queue.isEmpty() && canStart(Priority(priority))) {
+            const Task task = queue.dequeue();
+
+            PluginCall * const call = task.call;
+
+            // The call may have been canceled while it was queued.
+            if (call && !call->isFinished()) {
+                ++active;
+
+                connect(call, &QObject::destroyed, this, [this, &active]() {
+                    --active;
+                    dispatch();
+                });
+
+                task.start(call);
+            }
+        }
+
+        if (!queue.isEmpty()) {
+            blocked = true;
+        }
+    }
+}
+
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef NEMODEVICELOCK_PLUGINSCHEDULER_H
+#define NEMODEVICELOCK_PLUGINSCHEDULER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QQueue>
+
+#include <functional>
+
+namespace NemoDeviceLock
+{
+
+class PluginCall;
+
+// Limits the number of plugin invocations in progress at once and starts queued invocations in
+// order of priority, so that a slow settings change can't hold up an unlock.
+//
+// Unless invocations are serialized one slot of the shared pool is reserved for lock state
+// changes, and maintenance invocations run in a slot of their own outside the pool so a device
+// reset or home encryption can't hold up authentication or a settings change.  A slot is held until the call is
+// deleted, which for an abandoned in-process call isn't until its worker thread returns.
+class PluginScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    enum Priority {
+        LockStatePriority,
+        AuthenticationPriority,
+        SettingsPriority,
+        MaintenancePriority,
+        PriorityCount
+    };
+
+    explicit PluginScheduler(int maximumActive, QObject *parent = nullptr);
+    ~PluginScheduler();
+
+    int maximumActive() const;
+    int activeCount() const;
+    int queuedCount() const;
+
+    void schedule(PluginCall *call, Priority priority, const std::function<void(PluginCall *call)> &start);
+
+private:
+    inline bool hasOwnSlot(Priority priority) const;
+
+    struct Task
+    {
+        QPointer<PluginCall> call;
+        std::function<void(PluginCall *call)> start;
+    };
+
+    inline bool canStart(Priority priority) const;
+    inline void dispatch();
+
+    QQueue<Task> m_queues[PriorityCount];
+    const int m_maximumActive;
+    int m_active;
+    int m_maintenanceActive;
+};
+
+}
+
+#endif
@@ -0,0 +1,384 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "connectionregistry.h"
+
+#include "broadcastmessage.h"
+#include "hostobject.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+
+#include <dbus/dbus.h>
+#include <sys/socket.h>
+
+namespace NemoDeviceLock
+{
+
+// Compares the start time of the process with the pid now to the start time recorded with the
+// credentials, if they differ the process has exited and the pid been reused.  If the start time
+// couldn't be recorded there's nothing to compare and the pid is trusted as it was before.
+bool ConnectionCredentials::isCurrent() const
+{
+    return pid != 0 && (startTime == 0 || processStartTime(pid) == startTime);
+}
+
+ConnectionCredentials ConnectionCredentials::query(const QDBusConnection &connection)
+{
+    ConnectionCredentials credentials;
+
+    const auto internalConnection = static_cast<DBusConnection *>(connection.internalPointer());
+
+    int fd = -1;
+    struct ucred peer;
+    socklen_t length = sizeof(peer);
+
+    if (dbus_connection_get_socket(internalConnection, &fd)
+            && getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &length) == 0) {
+        credentials.pid = peer.pid;
+        credentials.uid = peer.uid;
+        credentials.gid = peer.gid;
+    } else {
+        if (!dbus_connection_get_unix_process_id(internalConnection, &credentials.pid)) {
+            credentials.pid = 0;
+        }
+        if (!dbus_connection_get_unix_user(internalConnection, &credentials.uid)) {
+            credentials.uid = -1;
+        }
+    }
+
+    if (credentials.pid != 0) {
+        credentials.startTime = processStartTime(credentials.pid);
+    }
+
+    return credentials;
+}
+
+// The start time of a process in clock ticks since boot, from field 22 of /proc/<pid>/stat.
+quint64 ConnectionCredentials::processStartTime(unsigned long pid)
+{
+    QFile file(QStringLiteral("/proc/%1/stat").arg(pid));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+
+    const QByteArray stat = file.readAll();
+
+    // The command name may contain spaces, the fields following it are counted from its
+    // closing parenthesis, which is followed by field 3.
+    const int commandEnd = stat.lastIndexOf(')');
+    if (commandEnd < 0) {
+        return 0;
+    }
+
+    const QList<QByteArray> fields = stat.mid(commandEnd + 2).split(' ');
+
+    return fields.value(22 - 3).toULongLong();
+}
+
+ConnectionRegistry *ConnectionRegistry::sharedInstance = nullptr;
+
+ConnectionRegistry::ConnectionRegistry()
+    : m_objectCount(0)
+    , m_encodedBroadcastCount(0)
+    , m_unencodedBroadcastCount(0)
+    , m_failedSendCount(0)
+    , m_deliveryCount(0)
+    , m_suppressedDeliveryCount(0)
+{
+    Q_ASSERT(!sharedInstance);
+    sharedInstance = this;
+}
+
+ConnectionRegistry::~ConnectionRegistry()
+{
+    for (const auto connection : m_connections) {
+        if (connection->connection) {
+            dbus_connection_unref(connection->connection);
+        }
+        delete connection;
+    }
+
+    sharedInstance = nullptr;
+}
+
+ConnectionRegistry *ConnectionRegistry::instance()
+{
+    return sharedInstance;
+}
+
+void ConnectionRegistry::addObject(HostObject *object)
+{
+    if (m_objectCount == MaximumObjects) {
+        qCWarning(daemon, "Too many objects, %s will not receive connections", qPrintable(object->path()));
+        return;
+    }
+
+    object->m_registry = this;
+    object->m_registryIndex = m_objectCount++;
+}
+
+void ConnectionRegistry::insert(const QDBusConnection &connection)
+{
+    Connection *&entry = m_connections[connection.name()];
+
+    if (!entry) {
+        entry = new Connection;
+        entry->name = connection.name();
+        entry->connection = dbus_connection_ref(static_cast<DBusConnection *>(connection.internalPointer()));
+    }
+
+    entry->credentials = ConnectionCredentials::query(connection);
+}
+
+void ConnectionRegistry::remove(const QString &connectionName)
+{
+    Connection * const connection = m_connections.take(connectionName);
+    if (!connection) {
+        return;
+    }
+
+    for (int object = 0; object < m_objectCount; ++object) {
+        if (connection->members & (quint64(1) << object)) {
+            removeMember(connection, object);
+        }
+    }
+
+    if (connection->connection) {
+        dbus_connection_unref(connection->connection);
+    }
+
+    delete connection;
+
+    m_writer.discard(connectionName);
+}
+
+void ConnectionRegistry::join(const QString &connectionName, int object)
+{
+    if (object < 0) {
+        return;
+    }
+
+    const quint64 mask = quint64(1) << object;
+    Connection * const connection = m_connections.value(connectionName);
+
+    if (connection && !(connection->members & mask)) {
+        connection->members |= mask;
+        connection->memberIndexes[object] = m_members[object].count();
+        m_members[object].append(connection);
+    }
+}
+
+void ConnectionRegistry::leave(const QString &connectionName, int object)
+{
+    if (object < 0) {
+        return;
+    }
+
+    Connection * const connection = m_connections.value(connectionName);
+
+    if (connection && (connection->members & (quint64(1) << object))) {
+        removeMember(connection, object);
+    }
+}
+
+// Removes a connection from the members of an object by moving the last member into its place.
+void ConnectionRegistry::removeMember(Connection *connection, int object)
+{
+    QVector<Connection *> &members = m_members[object];
+    const int index = connection->memberIndexes[object];
+
+    Connection * const last = members.last();
+    members[index] = last;
+    last->memberIndexes[object] = index;
+    members.removeLast();
+
+    connection->members &= ~(quint64(1) << object);
+}
+
+bool ConnectionRegistry::isMember(const QString &connectionName, int object) const
+{
+    const Connection * const connection = m_connections.value(connectionName);
+
+    return object >= 0 && connection && (connection->members & (quint64(1) << object));
+}
+
+// Whether a host object has been asked to authorize a connection, when objects are registered
+// lazily this is done on the first call to the object.
+bool ConnectionRegistry::isAuthorizationChecked(const QString &connectionName, int object) const
+{
+    const Connection * const connection = m_connections.value(connectionName);
+
+    return object >= 0 && connection && (connection->checked & (quint64(1) << object));
+}
+
+void ConnectionRegistry::setAuthorizationChecked(const QString &connectionName, int object)
+{
+    if (Connection * const connection = m_connections.value(connectionName)) {
+        if (object >= 0) {
+            connection->checked |= quint64(1) << object;
+        }
+    }
+}
+
+int ConnectionRegistry::count() const
+{
+    return m_connections.count();
+}
+
+int ConnectionRegistry::memberCount(int object) const
+{
+    return object >= 0 && object < m_objectCount ? m_members[object].count() : 0;
+}
+
+// Several clients can share a connection, each using a different object, so subscriptions are
+// tracked per object and the signals of an object are only filtered on a connection while there
+// are subscriptions to it.  Unsubscribing from the last interface of an object restores delivery
+// of all its signals.
+void ConnectionRegistry::subscribe(
+        const QString &connectionName, int object, const QString &interface, bool subscribed)
+{
+    Connection * const connection = m_connections.value(connectionName);
+    if (!connection || object < 0) {
+        return;
+    }
+
+    if (subscribed) {
+        connection->subscriptions[object].insert(interface);
+    } else {
+        const auto it = connection->subscriptions.find(object);
+        if (it != connection->subscriptions.end()) {
+            it->remove(interface);
+            if (it->isEmpty()) {
+                connection->subscriptions.erase(it);
+            }
+        }
+    }
+}
+
+bool ConnectionRegistry::isSubscribed(const QString &connectionName, int object, const QString &interface) const
+{
+    const Connection * const connection = m_connections.value(connectionName);
+
+    return connection && connection->isSubscribed(object, interface);
+}
+
+// Sends a signal to every connection an object is registered on which is subscribed to an
+// interface and returns the number of connections it was sent to.  Only the object's own members
+// are visited, not every connection to the daemon.
+int ConnectionRegistry::broadcast(int object, const QString &interface, const BroadcastMessage &message)
+{
+    if (object < 0 || m_members[object].isEmpty()) {
+        return 0;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    int recipients = 0;
+
+    for (const Connection * const connection : m_members[object]) {
+        if (!connection->isSubscribed(object, interface)) {
+            ++m_suppressedDeliveryCount;
+            continue;
+        }
+
+        if (!m_writer.post(
+                    connection->connection,
+                    connection->name,
+                    message.encodedMessage(),
+                    message.message(),
+                    message.coalesceKeys())) {
+            ++m_failedSendCount;
+        }
+        ++recipients;
+    }
+
+    m_deliveryCount += recipients;
+
+    const qint64 elapsed = timer.nsecsElapsed();
+
+    if (message.isEncoded()) {
+        ++m_encodedBroadcastCount;
+    } else {
+        ++m_unencodedBroadcastCount;
+    }
+
+    m_broadcastLatency.record(elapsed / 1000);
+    if (recipients > 0) {
+        m_recipientCost.record(elapsed / recipients);
+    }
+
+    return recipients;
+}
+
+// Sends a message to a connection from the writer thread.  Messages posted to a connection are
+// written in order with any broadcast signals.  A connection which isn't in the registry, such as
+// the system bus, has no broadcasts to be ordered with and is sent the message directly.
+bool ConnectionRegistry::post(const QString &connectionName, const QDBusMessage &message)
+{
+    if (const Connection * const connection = m_connections.value(connectionName)) {
+        return m_writer.post(connection->connection, connectionName, nullptr, message);
+    } else {
+        return QDBusConnection(connectionName).send(message);
+    }
+}
+
+PeerWriter *ConnectionRegistry::writer()
+{
+    return &m_writer;
+}
+
+// The broadcast latency is in microseconds and the cost per recipient in nanoseconds.  Suppressed
+// deliveries are signals not sent to, and so not waking, clients which weren't subscribed.
+QVariantMap ConnectionRegistry::broadcastStatistics() const
+{
+    return {
+        { QStringLiteral("deliveries"), m_deliveryCount },
+        { QStringLiteral("suppressedDeliveries"), m_suppressedDeliveryCount },
+        { QStringLiteral("encoded"), m_encodedBroadcastCount },
+        { QStringLiteral("unencoded"), m_unencodedBroadcastCount },
+        { QStringLiteral("refusedSends"), m_failedSendCount },
+        { QStringLiteral("writer"), m_writer.statistics() },
+        { QStringLiteral("latency"), m_broadcastLatency.toMap() },
+        { QStringLiteral("recipientCost"), m_recipientCost.toMap() }
+    };
+}
+
+const ConnectionCredentials *ConnectionRegistry::credentials(const QString &connectionName) const
+{
+    const Connection * const connection = m_connections.value(connectionName);
+
+    return connection ? &connection->credentials : nullptr;
+}
+
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef NEMODEVICELOCK_CONNECTIONREGISTRY_H
+#define NEMODEVICELOCK_CONNECTIONREGISTRY_H
+
+#include <nemo-devicelock/host/latencyhistogram.h>
+#include <nemo-devicelock/host/peerwriter.h>
+
+#include <QDBusConnection>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+
+struct DBusConnection;
+
+namespace NemoDeviceLock
+{
+
+struct ConnectionCredentials
+{
+    unsigned long pid = 0;
+    unsigned long uid = -1;
+    unsigned long gid = -1;
+    quint64 startTime = 0;
+
+    bool isCurrent() const;
+
+    static ConnectionCredentials query(const QDBusConnection &connection);
+    static quint64 processStartTime(unsigned long pid);
+};
+
+class BroadcastMessage;
+class HostObject;
+
+// The connections to the daemon's peer to peer socket.  The credentials of a peer are captured
+// once when its connection is authenticated and discarded when it's disconnected.  The host
+// objects registered on a connection are recorded as a bit mask, and each object keeps a list of
+// its member connections with each connection remembering its position in the list, so joining,
+// leaving and broadcasting don't require searching every connection.
+class ConnectionRegistry
+{
+public:
+    enum { MaximumObjects = 64 };
+
+    ConnectionRegistry();
+    ~ConnectionRegistry();
+
+    static ConnectionRegistry *instance();
+
+    void addObject(HostObject *object);
+
+    void insert(const QDBusConnection &connection);
+    void remove(const QString &connectionName);
+
+    void join(const QString &connectionName, int object);
+    void leave(const QString &connectionName, int object);
+    bool isMember(const QString &connectionName, int object) const;
+
+    bool isAuthorizationChecked(const QString &connectionName, int object) const;
+    void setAuthorizationChecked(const QString &connectionName, int object);
+
+    int count() const;
+    int memberCount(int object) const;
+
+    void subscribe(const QString &connectionName, int object, const QString &interface, bool subscribed);
+    bool isSubscribed(const QString &connectionName, int object, const QString &interface) const;
+
+    int broadcast(int object, const QString &interface, const BroadcastMessage &message);
+    bool post(const QString &connectionName, const QDBusMessage &message);
+
+    PeerWriter *writer();
+    QVariantMap broadcastStatistics() const;
+
+    const ConnectionCredentials *credentials(const QString &connectionName) const;
+
+private:
+    Q_DISABLE_COPY(ConnectionRegistry)
+
+    struct Connection
+    {
+        QString name;
+        ConnectionCredentials credentials;
+        DBusConnection *connection = nullptr;
+        int memberIndexes[MaximumObjects];
+        quint64 members = 0;
+        quint64 checked = 0;
+        QHash<int, QSet<QString>> subscriptions;
+
+        inline bool isSubscribed(int object, const QString &interface) const
+        {
+            const auto it = subscriptions.constFind(object);
+            return it == subscriptions.constEnd() || it->contains(interface);
+        }
+    };
+
+    inline void removeMember(Connection *connection, int object);
+
+    QHash<QString, Connection *> m_connections;
+    QVector<Connection *> m_members[MaximumObjects];
+    PeerWriter m_writer;
+    int m_objectCount;
+    LatencyHistogram m_broadcastLatency;
+    LatencyHistogram m_recipientCost;
+    int m_encodedBroadcastCount;
+    int m_unencodedBroadcastCount;
+    int m_failedSendCount;
+    int m_deliveryCount;
+    int m_suppressedDeliveryCount;
+
+    static ConnectionRegistry *sharedInstance;
+};
+
+}
+
+#endif
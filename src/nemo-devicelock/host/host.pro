@@ -22,32 +22,44 @@ INCLUDEPATH += \
 LIBS += -L$$OUT_PWD/.. -lnemodevicelock
 
 PUBLIC_HEADERS += \
+        $$PWD/broadcastmessage.h \
+        $$PWD/connectionregistry.h \
         $$PWD/hostauthenticationinput.h \
         $$PWD/hostauthenticator.h \
         $$PWD/hostauthorization.h \
         $$PWD/hostdevicelock.h \
         $$PWD/hostdevicelocksettings.h \
         $$PWD/hostdevicereset.h \
+        $$PWD/hostdiagnostics.h \
         $$PWD/hostencryptionsettings.h \
         $$PWD/hostfingerprintsensor.h \
         $$PWD/hostfingerprintsettings.h \
         $$PWD/hostobject.h \
+        $$PWD/hostobjectdispatcher.h \
         $$PWD/hostservice.h \
-        $$PWD/mcedevicelock.h
+        $$PWD/latencyhistogram.h \
+        $$PWD/mcedevicelock.h \
+        $$PWD/peerwriter.h
 
 SOURCES += \
+        $$PWD/broadcastmessage.cpp \
+        $$PWD/connectionregistry.cpp \
         $$PWD/hostauthenticationinput.cpp \
         $$PWD/hostauthenticator.cpp \
         $$PWD/hostauthorization.cpp \
         $$PWD/hostdevicelock.cpp \
         $$PWD/hostdevicelocksettings.cpp \
         $$PWD/hostdevicereset.cpp \
+        $$PWD/hostdiagnostics.cpp \
         $$PWD/hostencryptionsettings.cpp \
         $$PWD/hostfingerprintsensor.cpp \
         $$PWD/hostfingerprintsettings.cpp \
         $$PWD/hostobject.cpp \
+        $$PWD/hostobjectdispatcher.cpp \
         $$PWD/hostservice.cpp \
-        $$PWD/mcedevicelock.cpp
+        $$PWD/latencyhistogram.cpp \
+        $$PWD/mcedevicelock.cpp \
+        $$PWD/peerwriter.cpp
 
 include (cli/cli.pri)
 
@@ -115,7 +115,7 @@ void HostAuthenticationInput::startAuthentication(
         const QVariantMap &data,
         Authenticator::Methods methods)
 {
-    const uint pid = connectionPid(QDBusContext::connection());
+    const uint pid = connectionPid(HostObject::connection());
     if (pid != 0) {
         startAuthentication(feedback, pid, data, methods);
     }
@@ -146,7 +146,7 @@ void HostAuthenticationInput::startAuthentication(
 
 void HostAuthenticationInput::authenticationUnavailable(AuthenticationInput::Error error)
 {
-    const uint pid = connectionPid(QDBusContext::connection());
+    const uint pid = connectionPid(HostObject::connection());
     if (pid != 0) {
         authenticationUnavailable(error, pid);
     }
@@ -238,14 +238,14 @@ void HostAuthenticationInput::authenticationEnded(bool confirmed)
 
 void HostAuthenticationInput::setRegistered(const QString &path, bool registered)
 {
-    const auto pid = connectionPid(QDBusContext::connection());
+    const auto pid = verifiedConnectionPid(HostObject::connection());
 
     if (pid == 0 || !authorizeInput(pid)) {
-        QDBusContext::sendErrorReply(QDBusError::AccessDenied);
+        HostObject::sendErrorReply(QDBusError::AccessDenied);
         return;
     }
 
-    const auto connection = QDBusContext::connection().name();
+    const auto connection = HostObject::connection().name();
 
     if (registered) {
         for (int i = 0; i < m_inputStack.count(); ++i) {
@@ -256,6 +256,7 @@ void HostAuthenticationInput::setRegistered(const QString &path, bool registered
                 return;
             } else {
                 m_inputStack.removeAt(i);
+                --m_inputCounts[connection];
                 break;
             }
         }
@@ -265,6 +266,7 @@ void HostAuthenticationInput::setRegistered(const QString &path, bool registered
         }
 
         m_inputStack.append(Input(connection, path));
+        ++m_inputCounts[connection];
     } else for (int i = 0; i < m_inputStack.count(); ++i) {
         const auto &input = m_inputStack.at(i);
 
@@ -278,13 +280,17 @@ void HostAuthenticationInput::setRegistered(const QString &path, bool registered
 
         m_inputStack.removeAt(i);
 
+        if (--m_inputCounts[connection] == 0) {
+            m_inputCounts.remove(connection);
+        }
+
         break;
     }
 }
 
 void HostAuthenticationInput::setActive(const QString &path, bool active)
 {
-    const auto connection = QDBusContext::connection().name();
+    const auto connection = HostObject::connection().name();
 
     if (m_authenticating
             && !m_inputStack.isEmpty()
@@ -405,6 +411,12 @@ void HostAuthenticationInput::lockedOut(
 }
 
 
+// Called when an evaluation of a code is canceled.  An implementation may abandon the evaluation
+// but must still report a result.
+void HostAuthenticationInput::abortCheckCode()
+{
+}
+
 void HostAuthenticationInput::abortAuthentication(AuthenticationInput::Error error)
 {
     if (m_authenticating) {
@@ -423,7 +435,10 @@ void HostAuthenticationInput::abortAuthentication(AuthenticationInput::Error err
 
 void HostAuthenticationInput::clientDisconnected(const QString &connection)
 {
-    for (int i = 0; i < m_inputStack.count(); ) {
+    // Most connections never register an input, don't search the stack for those.
+    const int inputCount = m_inputCounts.take(connection);
+
+    for (int i = 0; inputCount > 0 && i < m_inputStack.count(); ) {
         if (m_inputStack.at(i).connection == connection) {
 
             if (i == m_inputStack.count() - 1) {
@@ -441,7 +456,7 @@ void HostAuthenticationInput::clientDisconnected(const QString &connection)
 
 void HostAuthenticationInput::handleEnterSecurityCode(const QString &path, const QString &code)
 {
-    const auto connection = QDBusContext::connection().name();
+    const auto connection = HostObject::connection().name();
     if (!m_inputStack.isEmpty()
             && m_inputStack.last().connection == connection
             && m_inputStack.last().path == path) {
@@ -451,7 +466,7 @@ void HostAuthenticationInput::handleEnterSecurityCode(const QString &path, const
 
 void HostAuthenticationInput::handleRequestSecurityCode(const QString &path)
 {
-    const auto connection = QDBusContext::connection().name();
+    const auto connection = HostObject::connection().name();
     if (!m_inputStack.isEmpty()
             && m_inputStack.last().connection == connection
             && m_inputStack.last().path == path) {
@@ -461,7 +476,7 @@ void HostAuthenticationInput::handleRequestSecurityCode(const QString &path)
 
 void HostAuthenticationInput::handleCancel(const QString &path)
 {
-    const auto connection = QDBusContext::connection().name();
+    const auto connection = HostObject::connection().name();
     if (!m_inputStack.isEmpty()
             && m_inputStack.last().connection == connection
             && m_inputStack.last().path == path) {
@@ -471,7 +486,7 @@ void HostAuthenticationInput::handleCancel(const QString &path)
 
 void HostAuthenticationInput::handleAuthorize(const QString &path)
 {
-    const auto connection = QDBusContext::connection().name();
+    const auto connection = HostObject::connection().name();
     if (!m_inputStack.isEmpty()
             && m_inputStack.last().connection == connection
             && m_inputStack.last().path == path) {
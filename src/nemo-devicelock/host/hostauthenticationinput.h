@@ -36,6 +36,8 @@
 #include <nemo-devicelock/authenticationinput.h>
 #include <nemo-devicelock/host/hostobject.h>
 
+#include <QHash>
+
 QT_BEGIN_NAMESPACE
 class QDBusConnection;
 QT_END_NAMESPACE
@@ -73,7 +75,8 @@ public:
         SecurityCodeExpired     = -2,
         SecurityCodeInHistory   = -3,
         LockedOut               = -4,
-        Evaluating              = -5
+        Evaluating              = -5,
+        TimedOut                = -256  // Outside the range of plugin exit codes.
     };
 
     enum Availability {
@@ -99,6 +102,7 @@ public:
     virtual Availability availability(QVariantMap *feedbackData = nullptr) const = 0;
     virtual int checkCode(const QString &code) = 0;
     virtual int setCode(const QString &oldCode, const QString &newCode) = 0;
+    virtual void abortCheckCode();
 
     // AuthenticationInput
     virtual bool authorizeInput(unsigned long pid);
@@ -190,6 +194,7 @@ private:
     HostAuthenticationInputAdaptor m_adaptor;
     QExplicitlySharedDataPointer<SettingsWatcher> m_settings;
     QVector<Input> m_inputStack;
+    QHash<QString, int> m_inputCounts;
     Authenticator::Methods m_supportedMethods;
     Authenticator::Methods m_activeMethods;
     bool m_authenticating;
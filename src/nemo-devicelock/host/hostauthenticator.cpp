@@ -115,6 +115,9 @@ HostAuthenticator::HostAuthenticator(Authenticator::Methods supportedMethods, QO
     , m_authenticatingPid(0)
     , m_state(Idle)
 {
+    // A settings reload can change the availability and available methods together.
+    setPropertyChangesCoalesced(true);
+
     systemBus().registerObject(path(), this);
 }
 
@@ -141,7 +144,7 @@ bool HostAuthenticator::isSecurityCodeSet() const
 void HostAuthenticator::authenticate(
         const QString &client, const QVariant &challengeCode, Authenticator::Methods methods)
 {
-    const auto pid = connectionPid(QDBusContext::connection());
+    const auto pid = connectionPid(HostObject::connection());
 
     cancelPending();
 
@@ -149,9 +152,9 @@ void HostAuthenticator::authenticate(
         setActiveClient(client);
         beginAuthenticate(pid, challengeCode, methods);
     } else {
-        m_pending.connection = QDBusContext::connection().name();
+        m_pending.connection = HostObject::connection().name();
         m_pending.client = client;
-        m_pending.address = QDBusContext::message().service();
+        m_pending.address = HostObject::message().service();
         m_pending.pid = pid;
         m_pending.request = AuthenticateRequest;
         m_pending.challengeCode = challengeCode;
@@ -178,7 +181,7 @@ void HostAuthenticator::beginAuthenticate(
             authenticated(authenticateChallengeCode(
                               challengeCode,
                               Authenticator::NoAuthentication,
-                              connectionPid(QDBusContext::connection())));
+                              connectionPid(HostObject::connection())));
         }
         break;
     case CanAuthenticateSecurityCode:
@@ -213,7 +216,7 @@ void HostAuthenticator::requestPermission(
         const QVariantMap &properties,
         Authenticator::Methods methods)
 {
-    const auto pid = connectionPid(QDBusContext::connection());
+    const auto pid = connectionPid(HostObject::connection());
 
     cancelPending();
 
@@ -221,7 +224,7 @@ void HostAuthenticator::requestPermission(
         setActiveClient(client);
         beginRequestPermission(pid, message, properties, methods);
     } else {
-        m_pending.connection = QDBusContext::connection().name();
+        m_pending.connection = HostObject::connection().name();
         m_pending.client = client;
         m_pending.pid = pid;
         m_pending.request = PermissionRequest;
@@ -275,9 +278,9 @@ void HostAuthenticator::beginRequestPermission(
 
 void HostAuthenticator::handleChangeSecurityCode(const QString &client, const QVariant &challengeCode)
 {
-    const auto pid = connectionPid(QDBusContext::connection());
+    const auto pid = verifiedConnectionPid(HostObject::connection());
     if (pid == 0 || !authorizeSecurityCodeSettings(pid)) {
-        QDBusContext::sendErrorReply(QDBusError::AccessDenied);
+        HostObject::sendErrorReply(QDBusError::AccessDenied);
         return;
     }
 
@@ -287,7 +290,7 @@ void HostAuthenticator::handleChangeSecurityCode(const QString &client, const QV
         setActiveClient(client);
         beginChangeSecurityCode(pid, challengeCode);
     } else {
-        m_pending.connection = QDBusContext::connection().name();
+        m_pending.connection = HostObject::connection().name();
         m_pending.client = client;
         m_pending.pid = pid;
         m_pending.request = ChangeRequest;
@@ -330,9 +333,9 @@ void HostAuthenticator::beginChangeSecurityCode(uint pid, const QVariant &challe
 
 void HostAuthenticator::handleClearSecurityCode(const QString &client)
 {
-    const auto pid = connectionPid(QDBusContext::connection());
+    const auto pid = verifiedConnectionPid(HostObject::connection());
     if (pid == 0 || !authorizeSecurityCodeSettings(pid)) {
-        QDBusContext::sendErrorReply(QDBusError::AccessDenied);
+        HostObject::sendErrorReply(QDBusError::AccessDenied);
         return;
     }
 
@@ -342,7 +345,7 @@ void HostAuthenticator::handleClearSecurityCode(const QString &client)
         setActiveClient(client);
         beginClearSecurityCode(pid);
     } else {
-        m_pending.connection = QDBusContext::connection().name();
+        m_pending.connection = HostObject::connection().name();
         m_pending.client = client;
         m_pending.pid = pid;
         m_pending.request = ClearRequest;
@@ -357,7 +360,7 @@ void HostAuthenticator::beginClearSecurityCode(uint pid)
     switch (availability()) {
     case AuthenticationNotRequired:
         m_state = Idle;
-        QDBusContext::sendErrorReply(QDBusError::InvalidArgs);
+        HostObject::sendErrorReply(QDBusError::InvalidArgs);
         break;
     case CanAuthenticateSecurityCode:
     case CanAuthenticate:
@@ -382,6 +385,7 @@ void HostAuthenticator::enterSecurityCode(const QString &code)
     case Authenticating:
         qCDebug(daemon, "Security code entered for authentication.");
         m_state = AuthenticationEvaluating;
+        m_authenticationTimer.start();
         checkCodeFinished(checkCode(code));
         return;
     case RequestingPermission:
@@ -517,6 +521,9 @@ void HostAuthenticator::checkCodeFinished(int result)
         case LockedOut:
             lockedOut();
             return;
+        case TimedOut:
+            abortAuthentication(AuthenticationInput::SoftwareError);
+            return;
         }
         break;
     case AuthenticationCanceled:
@@ -547,6 +554,9 @@ void HostAuthenticator::checkCodeFinished(int result)
         case LockedOut:
             lockedOut();
             return;
+        case TimedOut:
+            abortAuthentication(AuthenticationInput::SoftwareError);
+            return;
         }
         break;
     case AuthenticationForChangeCanceled:
@@ -559,12 +569,11 @@ void HostAuthenticator::checkCodeFinished(int result)
             m_state = State(m_state | EvaluatingFlag);
             return;
         case Success:
-            if (clearCode(m_currentCode)) {
-                securityCodeCleared();
-            } else {
-                abortAuthentication(AuthenticationInput::SoftwareError);
-            }
+            clearCodeFinished(clearCode(m_currentCode));
+            return;
+        case TimedOut:
             m_currentCode.clear();
+            abortAuthentication(AuthenticationInput::SoftwareError);
             return;
         }
         break;
@@ -629,13 +638,62 @@ void HostAuthenticator::setCodeFinished(int result)
         m_currentCode.clear();
         qCDebug(daemon, "Security code change failed.");
 
-        abortAuthentication(AuthenticationInput::SoftwareError);
+        if (m_state == ChangeCanceled) {
+            securityCodeChangeAborted();
+        } else {
+            abortAuthentication(AuthenticationInput::SoftwareError);
+        }
+        break;
+    }
+}
+
+void HostAuthenticator::clearCodeFinished(int result)
+{
+    switch (result) {
+    case Success:
+        m_currentCode.clear();
+
+        qCDebug(daemon, "Security code cleared.");
+        securityCodeCleared();
+        break;
+    case Evaluating:
+        if (m_state == AuthenticatingForClear) {
+            m_state = Clearing;
+            authenticationEvaluating();
+        } else {
+            m_currentCode.clear();
+            abortAuthentication(AuthenticationInput::SoftwareError);
+        }
+        break;
+    default:
+        m_currentCode.clear();
+        qCDebug(daemon, "Security code clear failed.");
+
+        if (m_state == ClearCanceled) {
+            securityCodeClearAborted();
+        } else {
+            abortAuthentication(AuthenticationInput::SoftwareError);
+        }
         break;
     }
 }
 
 void HostAuthenticator::confirmAuthentication(Authenticator::Method method)
 {
+    // Time from the code being entered to the authentication token being sent to the client.
+    if (m_authenticationTimer.isValid()) {
+        const qint64 elapsed = m_authenticationTimer.nsecsElapsed() / 1000;
+        m_authenticationTimer.invalidate();
+
+        m_authenticationLatency.record(elapsed);
+
+        qCDebug(daemon, "Authenticated in %lldus. p50 %lldus, p95 %lldus, p99 %lldus.",
+                    elapsed,
+                    m_authenticationLatency.percentile(50),
+                    m_authenticationLatency.percentile(95),
+                    m_authenticationLatency.percentile(99));
+    }
+
     switch (m_state) {
     case Authenticating:
         authenticated(authenticateChallengeCode(m_challengeCode, method, m_authenticatingPid));
@@ -673,6 +731,7 @@ void HostAuthenticator::abortAuthentication(AuthenticationInput::Error error)
         m_state = ChangeError;
         break;
     case AuthenticatingForClear:
+    case Clearing:
         m_state = ClearError;
         break;
     default:
@@ -737,21 +796,29 @@ void HostAuthenticator::cancel()
     case Changing:
         m_state = ChangeCanceled;
         return;
+    case Clearing:
+        m_state = ClearCanceled;
+        return;
+    // A security code is being checked, there's no harm in abandoning that.
     case AuthenticationEvaluating:
     case PermissionEvaluating:
         m_state = AuthenticationCanceled;
         authenticationInactive();
+        abortCheckCode();
         return;
     case AuthenticationForChangeEvaluating:
-        m_state = AuthenticationForClearCanceled;
+        m_state = AuthenticationForChangeCanceled;
         authenticationInactive();
+        abortCheckCode();
         return;
     case AuthenticationForClearEvaluating:
-        m_state = AuthenticationForChangeCanceled;
+        m_state = AuthenticationForClearCanceled;
         authenticationInactive();
+        abortCheckCode();
         return;
     // Something has already tried to interrupt a time consuming and uninterruptable operation.
     case ChangeCanceled:
+    case ClearCanceled:
     case AuthenticationCanceled:
     case AuthenticationCompleted:
     case AuthenticationForChangeCanceled:
@@ -768,6 +835,8 @@ void HostAuthenticator::authenticated(const QVariant &authenticationToken)
 
 void HostAuthenticator::aborted()
 {
+    m_authenticationTimer.invalidate();
+
     sendToActiveClient(authenticatorInterface, QStringLiteral("Aborted"));
     authenticationEnded(false);
 }
@@ -815,8 +884,8 @@ void HostAuthenticator::availabilityChanged()
 
 void HostAuthenticator::handleCancel(const QString &client)
 {
-    const QString connection = QDBusContext::connection().name();
-    const QString address = QDBusContext::message().service();
+    const QString connection = HostObject::connection().name();
+    const QString address = HostObject::message().service();
 
     if (m_pending.request != NoRequest) {
         if (m_pending.connection == connection && m_pending.address == address && m_pending.client == client) {
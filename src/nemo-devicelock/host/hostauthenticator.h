@@ -41,6 +41,9 @@
 #include <nemo-dbus/interface.h>
 #include <nemo-devicelock/host/hostauthenticationinput.h>
 #include <nemo-devicelock/host/hostobject.h>
+#include <nemo-devicelock/host/latencyhistogram.h>
+
+#include <QElapsedTimer>
 
 QT_BEGIN_NAMESPACE
 class QDBusConnection;
@@ -111,7 +114,7 @@ public:
     // SecurityCodeSettings
     virtual bool authorizeSecurityCodeSettings(unsigned long pid);
 
-    virtual bool clearCode(const QString &code) = 0;
+    virtual int clearCode(const QString &code) = 0;
 
     // AuthenticationInput
     Availability availability(QVariantMap *feedbackData = nullptr) const override = 0;
@@ -131,6 +134,7 @@ public:
 
     void checkCodeFinished(int result);
     void setCodeFinished(int result);
+    void clearCodeFinished(int result);
 
     // Signals
     void authenticated(const QVariant &authenticationToken);
@@ -145,6 +149,9 @@ public:
     void availableMethodsChanged();
     void availabilityChanged();
 
+    // Diagnostics
+    const LatencyHistogram &authenticationLatency() const { return m_authenticationLatency; }
+
 private:
     enum StateFlag {
         ErrorFlag       = 0x1000,
@@ -164,6 +171,8 @@ private:
         Changing,
         ChangeCanceled,
         AuthenticatingForClear,
+        Clearing,
+        ClearCanceled,
 
         AuthenticationError         = Authenticating | ErrorFlag,
         AuthenticationEvaluating    = Authenticating | EvaluatingFlag,
@@ -219,6 +228,8 @@ private:
 
     HostAuthenticatorAdaptor m_adaptor;
     HostSecurityCodeSettingsAdaptor m_securityCodeAdaptor;
+    LatencyHistogram m_authenticationLatency;
+    QElapsedTimer m_authenticationTimer;
     struct Pending {
         QVariant challengeCode;
         QVariantMap properties;
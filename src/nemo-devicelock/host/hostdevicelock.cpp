@@ -72,10 +72,14 @@ HostDeviceLock::HostDeviceLock(Authenticator::Methods supportedMethods, QObject
     : HostAuthenticationInput(QStringLiteral("/devicelock/lock"), supportedMethods, parent)
     , m_adaptor(this)
     , m_settings(SettingsWatcher::instance())
+    , m_unlockEvaluated(0)
     , m_repeatsRequired(0)
     , m_state(Idle)
     , m_lockState(DeviceLock::Undefined)
 {
+    // Lock state changes from MCE can arrive several at a time.
+    setPropertyChangesCoalesced(true);
+
     connect(m_settings.data(), &SettingsWatcher::automaticLockingChanged,
             this, &HostDeviceLock::automaticLockingChanged);
 }
@@ -148,16 +152,21 @@ void HostDeviceLock::enterSecurityCode(const QString &code)
     case Idle:
         break;
     case Authenticating: {
+        m_unlockTimer.start();
+
         switch (const int result = unlockWithCode(code)) {
         case SecurityCodeExpired:
+            m_unlockTimer.invalidate();
             m_state = EnteringNewSecurityCode;
             m_currentCode = code;
             feedback(AuthenticationInput::SecurityCodeExpired, -1);
             enterCodeChangeState(&HostAuthenticationInput::feedback);
             break;
         case SecurityCodeInHistory:
+            m_unlockTimer.invalidate();
             break;
         case LockedOut:
+            m_unlockTimer.invalidate();
             lockedOut();
             break;
         case Evaluating:
@@ -230,8 +239,20 @@ void HostDeviceLock::requestSecurityCode()
     }
 }
 
+// Receives the result of a checkCode() which returned Evaluating.  The device lock itself only
+// evaluates a code as part of unlockWithCode() so by default the result is discarded.
+void HostDeviceLock::checkCodeFinished(int)
+{
+}
+
 void HostDeviceLock::unlockFinished(int result, Authenticator::Method method)
 {
+    if (result != Evaluating && result != Success) {
+        m_unlockTimer.invalidate();
+    } else if (result == Success && m_unlockTimer.isValid()) {
+        m_unlockEvaluated = m_unlockTimer.nsecsElapsed() / 1000;
+    }
+
     switch (result) {
     case Success:
         confirmAuthentication(method);
@@ -252,6 +273,7 @@ void HostDeviceLock::unlockFinished(int result, Authenticator::Method method)
         break;
     case SecurityCodeInHistory:
     case LockedOut:
+    case TimedOut:
         if (m_state == Canceled) {
             m_state = Idle;
 
@@ -263,6 +285,15 @@ void HostDeviceLock::unlockFinished(int result, Authenticator::Method method)
         }
         break;
     default: {
+        if (m_state == Canceled) {
+            m_state = Idle;
+
+            authenticationEnded(false);
+
+            unlockingChanged();
+            break;
+        }
+
         int attemptsRemaining = -1;
         const int maximum = maximumAttempts();
 
@@ -327,6 +358,10 @@ void HostDeviceLock::setCodeFinished(int result)
             authenticationEnded(false);
 
             unlockingChanged();
+        } else if (m_state == ChangingSecurityCode) {
+            // The change was evaluated asynchronously so there's no D-Bus context to report
+            // the authentication as unavailable through.
+            abortAuthentication(AuthenticationInput::SoftwareError);
         } else {
             m_state = AuthenticationError;
             authenticationUnavailable(AuthenticationInput::SoftwareError);
@@ -338,7 +373,11 @@ void HostDeviceLock::setCodeFinished(int result)
 
 void HostDeviceLock::cancel()
 {
-    if (m_state == Unlocking || m_state == ChangingSecurityCode) {
+    if (m_state == Unlocking) {
+        m_state = Canceled;
+
+        abortCheckCode();
+    } else if (m_state == ChangingSecurityCode) {
         m_state = Canceled;
     } else if (m_state != Idle && m_state != Canceled) {
         m_state = Idle;
@@ -430,6 +469,23 @@ void HostDeviceLock::stateChanged()
                     QStringLiteral("State"),
                     QVariant::fromValue(uint(m_lockState)));
     }
+
+    // Time from the code being entered to the unlocked state being sent to clients.
+    if (m_lockState == DeviceLock::Unlocked && m_unlockTimer.isValid()) {
+        const qint64 elapsed = m_unlockTimer.nsecsElapsed() / 1000;
+        m_unlockTimer.invalidate();
+
+        m_unlockEvaluationLatency.record(m_unlockEvaluated);
+        m_unlockPropagationLatency.record(elapsed - m_unlockEvaluated);
+        m_unlockLatency.record(elapsed);
+
+        qCDebug(daemon, "Unlocked in %lldus, %lldus evaluating the code. p50 %lldus, p95 %lldus, p99 %lldus.",
+                    elapsed,
+                    m_unlockEvaluated,
+                    m_unlockLatency.percentile(50),
+                    m_unlockLatency.percentile(95),
+                    m_unlockLatency.percentile(99));
+    }
 }
 
 void HostDeviceLock::lockedChanged()
@@ -36,8 +36,10 @@
 #include <nemo-devicelock/devicelock.h>
 #include <nemo-devicelock/host/hostauthenticationinput.h>
 #include <nemo-devicelock/host/hostobject.h>
+#include <nemo-devicelock/host/latencyhistogram.h>
 
 #include <QDBusVariant>
+#include <QElapsedTimer>
 
 namespace NemoDeviceLock
 {
@@ -105,11 +107,17 @@ public:
     void unlockFinished(int result, Authenticator::Method method);
     void setCodeFinished(int result);
 
+    // Diagnostics
+    const LatencyHistogram &unlockEvaluationLatency() const { return m_unlockEvaluationLatency; }
+    const LatencyHistogram &unlockPropagationLatency() const { return m_unlockPropagationLatency; }
+    const LatencyHistogram &unlockLatency() const { return m_unlockLatency; }
+
     // Signals
     void notice(DeviceLock::Notice notice, const QVariantMap &data);
 
 protected:
     virtual void stateChanged();
+    virtual void checkCodeFinished(int result);
 
 private:
     friend class HostDeviceLockAdaptor;
@@ -137,6 +145,11 @@ private:
     QString m_currentCode;
     QString m_newCode;
     QString m_generatedCode;
+    LatencyHistogram m_unlockEvaluationLatency;
+    LatencyHistogram m_unlockPropagationLatency;
+    LatencyHistogram m_unlockLatency;
+    QElapsedTimer m_unlockTimer;
+    qint64 m_unlockEvaluated;
     int m_repeatsRequired;
     State m_state;
     DeviceLock::LockState m_lockState;
@@ -32,6 +32,10 @@
 
 #include "hostdevicelocksettings.h"
 
+#include "settingswatcher.h"
+
+#include <time.h>
+
 namespace NemoDeviceLock
 {
 
@@ -50,14 +54,60 @@ void HostDeviceLockSettingsAdaptor::ChangeSetting(
     m_settings->changeSetting(path.path(), authenticationToken.variant(), key, value.variant());
 }
 
+void HostDeviceLockSettingsAdaptor::ChangeSettings(
+        const QDBusObjectPath &path,
+        const QDBusVariant &authenticationToken,
+        const QVariantMap &settings)
+{
+    m_settings->changeSettings(path.path(), authenticationToken.variant(), settings);
+}
+
 HostDeviceLockSettings::HostDeviceLockSettings(Authenticator::Methods allowedMethods, QObject *parent)
     : HostAuthorization(QStringLiteral("/devicelock/settings"), allowedMethods, parent)
     , m_adaptor(this)
+    , m_settings(SettingsWatcher::instance())
 {
+    // Clients read the settings parsed by the daemon rather than each parsing the settings
+    // file themselves.
+    m_settings->publishSnapshot();
+
+    connect(m_settings.data(), &SettingsWatcher::reloaded, this, &HostDeviceLockSettings::settingsReloaded);
 }
 
 HostDeviceLockSettings::~HostDeviceLockSettings()
 {
 }
 
+// Applies settings which have been successfully written so clients see them immediately
+// rather than after the settings file has been rewritten and reloaded.  Durations are in
+// microseconds from the settings file being modified until the values written to or read from it
+// are published to clients, the reload latency is how long clients would otherwise have waited.
+void HostDeviceLockSettings::settingsWritten(const QStringList &keysAndValues)
+{
+    if (m_settings->applyWrittenSettings(keysAndValues)) {
+        recordPublishLatency(&m_writeThroughLatency);
+    }
+}
+
+void HostDeviceLockSettings::settingsReloaded()
+{
+    recordPublishLatency(&m_reloadLatency);
+}
+
+// File modification times come from a coarse clock so a latency can be a tick longer than it was.
+void HostDeviceLockSettings::recordPublishLatency(LatencyHistogram *histogram)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    const qint64 published = qint64(now.tv_sec) * 1000000000 + now.tv_nsec;
+
+    histogram->record(qMax<qint64>(0, published - m_settings->publishedModified()) / 1000);
+}
+
+void HostDeviceLockSettings::changeSettings(const QString &, const QVariant &, const QVariantMap &)
+{
+    HostObject::sendErrorReply(QDBusError::NotSupported);
+}
+
 }
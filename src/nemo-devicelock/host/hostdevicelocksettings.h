@@ -34,8 +34,10 @@
 #define NEMODEVICELOCK_HOSTDEVICELOCKSETTINGS_H
 
 #include <nemo-devicelock/host/hostauthorization.h>
+#include <nemo-devicelock/host/latencyhistogram.h>
 
 #include <QDBusVariant>
+#include <QSharedData>
 
 namespace NemoDeviceLock
 {
@@ -54,11 +56,17 @@ public slots:
             const QDBusVariant &authenticationToken,
             const QString &key,
             const QDBusVariant &value);
+    void ChangeSettings(
+            const QDBusObjectPath &path,
+            const QDBusVariant &authenticationToken,
+            const QVariantMap &settings);
 
 private:
     HostDeviceLockSettings * const m_settings;
 };
 
+class SettingsWatcher;
+
 class HostDeviceLockSettings : public HostAuthorization
 {
     Q_OBJECT
@@ -66,17 +74,32 @@ public:
     explicit HostDeviceLockSettings(Authenticator::Methods allowedMethods, QObject *parent = nullptr);
     ~HostDeviceLockSettings();
 
+    const LatencyHistogram &writeThroughLatency() const { return m_writeThroughLatency; }
+    const LatencyHistogram &reloadLatency() const { return m_reloadLatency; }
+
 protected:
     virtual void changeSetting(
             const QString &requestor,
             const QVariant &authenticationToken,
             const QString &key,
             const QVariant &value) = 0;
+    virtual void changeSettings(
+            const QString &requestor,
+            const QVariant &authenticationToken,
+            const QVariantMap &settings);
+
+    void settingsWritten(const QStringList &keysAndValues);
 
 private:
     friend class HostDeviceLockSettingsAdaptor;
 
+    inline void settingsReloaded();
+    inline void recordPublishLatency(LatencyHistogram *histogram);
+
     HostDeviceLockSettingsAdaptor m_adaptor;
+    QExplicitlySharedDataPointer<SettingsWatcher> m_settings;
+    LatencyHistogram m_writeThroughLatency;
+    LatencyHistogram m_reloadLatency;
 };
 
 }
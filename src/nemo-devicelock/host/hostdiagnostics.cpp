@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "hostdiagnostics.h"
+
+#include "hostauthenticator.h"
+#include "hostdevicelock.h"
+#include "hostdevicelocksettings.h"
+#include "hostservice.h"
+
+#include "settingswatcher.h"
+
+#include <QFile>
+
+#include <unistd.h>
+
+namespace NemoDeviceLock
+{
+
+HostDiagnosticsAdaptor::HostDiagnosticsAdaptor(HostDiagnostics *diagnostics)
+    : QDBusAbstractAdaptor(diagnostics)
+    , m_diagnostics(diagnostics)
+{
+}
+
+QVariantMap HostDiagnosticsAdaptor::GetStatistics()
+{
+    return m_diagnostics->statistics();
+}
+
+HostDiagnostics::HostDiagnostics(
+        HostService *service,
+        HostAuthenticator *authenticator,
+        HostDeviceLock *deviceLock,
+        HostDeviceLockSettings *deviceLockSettings,
+        QObject *parent)
+    : QObject(parent)
+    , m_adaptor(this)
+    , m_service(service)
+    , m_authenticator(authenticator)
+    , m_deviceLock(deviceLock)
+    , m_deviceLockSettings(deviceLockSettings)
+{
+    systemBus().registerObject(QStringLiteral("/devicelock/diagnostics"), this);
+}
+
+HostDiagnostics::~HostDiagnostics()
+{
+}
+
+// The resident set size of the daemon in bytes.
+static qint64 residentMemory()
+{
+    QFile statm(QStringLiteral("/proc/self/statm"));
+    if (!statm.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+
+    return fields.value(1).toLongLong() * sysconf(_SC_PAGESIZE);
+}
+
+// Durations are in microseconds.
+QVariantMap HostDiagnostics::statistics() const
+{
+    QVariantMap statistics;
+
+    if (m_service) {
+        statistics.insert(QStringLiteral("connections"), m_service->statistics());
+    }
+
+    statistics.insert(QStringLiteral("residentMemory"), residentMemory());
+
+    if (m_authenticator) {
+        statistics.insert(
+                    QStringLiteral("authentication"),
+                    m_authenticator->authenticationLatency().toMap());
+    }
+
+    if (m_deviceLock) {
+        statistics.insert(QStringLiteral("unlock"), QVariantMap {
+            { QStringLiteral("evaluation"), m_deviceLock->unlockEvaluationLatency().toMap() },
+            { QStringLiteral("propagation"), m_deviceLock->unlockPropagationLatency().toMap() },
+            { QStringLiteral("total"), m_deviceLock->unlockLatency().toMap() }
+        });
+    }
+
+    const QExplicitlySharedDataPointer<SettingsWatcher> settings(SettingsWatcher::instance());
+    QVariantMap settingsStatistics {
+        { QStringLiteral("generation"), settings->state()->generation() },
+        { QStringLiteral("reloads"), settings->performedReloadCount() },
+        { QStringLiteral("suppressedReloads"), settings->suppressedReloadCount() },
+        { QStringLiteral("debouncedEvents"), settings->debouncedEventCount() },
+        { QStringLiteral("fastParses"), settings->fastParseCount() },
+        { QStringLiteral("fallbackParses"), settings->fallbackParseCount() },
+        { QStringLiteral("lastParseNs"), settings->lastParseDuration() }
+    };
+
+    if (m_deviceLockSettings) {
+        settingsStatistics.insert(
+                    QStringLiteral("writeThrough"), m_deviceLockSettings->writeThroughLatency().toMap());
+        settingsStatistics.insert(
+                    QStringLiteral("reload"), m_deviceLockSettings->reloadLatency().toMap());
+    }
+
+    statistics.insert(QStringLiteral("settings"), settingsStatistics);
+
+    return statistics;
+}
+
+}
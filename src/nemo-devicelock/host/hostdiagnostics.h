@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef NEMODEVICELOCK_HOSTDIAGNOSTICS_H
+#define NEMODEVICELOCK_HOSTDIAGNOSTICS_H
+
+#include <QDBusAbstractAdaptor>
+#include <QVariantMap>
+
+namespace NemoDeviceLock
+{
+
+class HostAuthenticator;
+class HostDeviceLock;
+class HostDeviceLockSettings;
+class HostService;
+
+class HostDiagnostics;
+class HostDiagnosticsAdaptor : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.nemomobile.devicelock.Diagnostics")
+public:
+    explicit HostDiagnosticsAdaptor(HostDiagnostics *diagnostics);
+
+public slots:
+    QVariantMap GetStatistics();
+
+private:
+    HostDiagnostics * const m_diagnostics;
+};
+
+// Publishes performance statistics of the daemon on the system bus.  The interface is read only
+// and the statistics contain nothing which would identify the user, but the timings and counts
+// still reveal when the device is used so the bus policy only lets root call it.
+class HostDiagnostics : public QObject
+{
+    Q_OBJECT
+public:
+    explicit HostDiagnostics(
+            HostService *service,
+            HostAuthenticator *authenticator,
+            HostDeviceLock *deviceLock,
+            HostDeviceLockSettings *deviceLockSettings = nullptr,
+            QObject *parent = nullptr);
+    ~HostDiagnostics();
+
+protected:
+    virtual QVariantMap statistics() const;
+
+private:
+    friend class HostDiagnosticsAdaptor;
+
+    HostDiagnosticsAdaptor m_adaptor;
+    HostService * const m_service;
+    HostAuthenticator * const m_authenticator;
+    HostDeviceLock * const m_deviceLock;
+    HostDeviceLockSettings * const m_deviceLockSettings;
+};
+
+}
+
+#endif
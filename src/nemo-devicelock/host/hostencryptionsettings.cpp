@@ -74,7 +74,7 @@ bool HostEncryptionSettings::isSupported() const
 
 void HostEncryptionSettings::encryptHome(const QString &, const QVariant &)
 {
-    QDBusContext::sendErrorReply(QDBusError::NotSupported);
+    HostObject::sendErrorReply(QDBusError::NotSupported);
 }
 
 }
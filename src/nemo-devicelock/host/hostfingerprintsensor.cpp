@@ -80,7 +80,7 @@ bool HostFingerprintSensor::hasSensor() const
 
 int HostFingerprintSensor::acquireFinger(const QString &, const QVariant &)
 {
-    QDBusContext::sendErrorReply(QDBusError::NotSupported);
+    HostObject::sendErrorReply(QDBusError::NotSupported);
     return 0;
 }
 
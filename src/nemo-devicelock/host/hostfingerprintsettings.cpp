@@ -81,12 +81,12 @@ QVector<Fingerprint> HostFingerprintSettings::fingerprints() const
 
 void HostFingerprintSettings::remove(const QString &, const QVariant &, const QVariant &)
 {
-    QDBusContext::sendErrorReply(QDBusError::NotSupported);
+    HostObject::sendErrorReply(QDBusError::NotSupported);
 }
 
 void HostFingerprintSettings::rename(const QVariant &, const QString &)
 {
-    QDBusContext::sendErrorReply(QDBusError::NotSupported);
+    HostObject::sendErrorReply(QDBusError::NotSupported);
 }
 
 void HostFingerprintSettings::fingerprintsChanged()
@@ -32,6 +32,9 @@
 
 #include "hostobject.h"
 
+#include "broadcastmessage.h"
+#include "connectionregistry.h"
+
 #include <QThreadStorage>
 
 #include <dbus/dbus.h>
@@ -58,9 +61,30 @@ NemoDBus::Connection systemBus()
     return bus.localData();
 }
 
+HostSubscriptionAdaptor::HostSubscriptionAdaptor(HostObject *object)
+    : QDBusAbstractAdaptor(object)
+    , m_object(object)
+{
+}
+
+void HostSubscriptionAdaptor::Subscribe(const QString &interface)
+{
+    m_object->subscribe(interface, true);
+}
+
+void HostSubscriptionAdaptor::Unsubscribe(const QString &interface)
+{
+    m_object->subscribe(interface, false);
+}
+
 HostObject::HostObject(const QString &path, QObject *parent)
     : QObject(parent)
+    , m_subscriptionAdaptor(this)
     , m_path(path)
+    , m_dispatchContext(nullptr)
+    , m_registry(nullptr)
+    , m_registryIndex(-1)
+    , m_coalescePropertyChanges(false)
 {
 }
 
@@ -79,12 +103,16 @@ void HostObject::cancel()
 
 void HostObject::clientConnected(const QString &connectionName)
 {
-    m_connections.append(connectionName);
+    if (m_registry) {
+        m_registry->join(connectionName, m_registryIndex);
+    }
 }
 
 void HostObject::clientDisconnected(const QString &connectionName)
 {
-    m_connections.removeOne(connectionName);
+    if (m_registry) {
+        m_registry->leave(connectionName, m_registryIndex);
+    }
 
     if (m_activeConnection == connectionName) {
         m_activeConnection.clear();
@@ -104,32 +132,138 @@ void HostObject::nameLost(const QString &name)
     }
 }
 
+bool HostObject::propertyChangesCoalesced() const
+{
+    return m_coalescePropertyChanges;
+}
+
+// By default each property change is sent as it happens, an object whose properties change in
+// bursts can instead have them accumulated and sent as a single PropertiesChanged signal per
+// interface when control returns to the event loop.
+void HostObject::setPropertyChangesCoalesced(bool coalesced)
+{
+    m_coalescePropertyChanges = coalesced;
+
+    if (!coalesced) {
+        flushPropertyChanges();
+    }
+}
+
 void HostObject::propertyChanged(const QString &interface, const QString &property, const QVariant &value)
 {
     qCDebug(daemon, "DBus property changed (%s %s.%s): %s",
             qPrintable(m_path), qPrintable(interface), qPrintable(property), qPrintable(value.toString()));
 
-    const QVariantMap properties = { { property, value } };
+    if (m_coalescePropertyChanges) {
+        if (m_changedProperties.isEmpty()) {
+            QMetaObject::invokeMethod(this, "flushPropertyChanges", Qt::QueuedConnection);
+        }
+
+        m_changedProperties[interface].insert(property, value);
+    } else {
+        const QVariantMap properties = { { property, value } };
 
-    broadcastSignal(
-                QStringLiteral("org.freedesktop.DBus.Properties"),
-                QStringLiteral("PropertiesChanged"),
-                NemoDBus::marshallArguments(interface, properties, QStringList()));
+        broadcastSignal(
+                    QStringLiteral("org.freedesktop.DBus.Properties"),
+                    QStringLiteral("PropertiesChanged"),
+                    QVariantList { interface, properties, QStringList() });
+    }
+}
+
+void HostObject::flushPropertyChanges()
+{
+    const auto changedProperties = m_changedProperties;
+    m_changedProperties.clear();
+
+    for (auto it = changedProperties.begin(); it != changedProperties.end(); ++it) {
+        broadcastSignal(
+                    QStringLiteral("org.freedesktop.DBus.Properties"),
+                    QStringLiteral("PropertiesChanged"),
+                    QVariantList { it.key(), it.value(), QStringList() });
+    }
 }
 
 void HostObject::broadcastSignal(const QString &interface, const QString &name, const QVariantList &arguments)
 {
-    QDBusMessage message = QDBusMessage::createSignal(m_path, interface, name);
+    // Deliver any property changes preceding the signal first so the order is preserved.
+    flushPropertyChanges();
+
+    if (m_registry && m_registry->memberCount(m_registryIndex) > 0) {
+        // Property changes are delivered to the subscribers of the interface the properties
+        // belong to rather than the properties interface.
+        const auto subscriptionInterface = interface == QLatin1String("org.freedesktop.DBus.Properties")
+                ? arguments.value(0).toString()
+                : interface;
+
+        m_registry->broadcast(
+                    m_registryIndex,
+                    subscriptionInterface,
+                    BroadcastMessage(m_path, interface, name, arguments));
+    }
+}
 
-    message.setArguments(arguments);
+QDBusConnection HostObject::connection() const
+{
+    return m_dispatchContext ? m_dispatchContext->connection : QDBusContext::connection();
+}
+
+const QDBusMessage &HostObject::message() const
+{
+    return m_dispatchContext ? m_dispatchContext->message : QDBusContext::message();
+}
 
-    for (const auto connectionName : m_connections) {
-        QDBusConnection(connectionName).send(message);
+void HostObject::sendErrorReply(QDBusError::ErrorType type, const QString &message) const
+{
+    if (m_dispatchContext) {
+        m_dispatchContext->delayedReply = true;
+        sendMessage(
+                    m_dispatchContext->connection.name(),
+                    m_dispatchContext->message.createErrorReply(type, message));
+    } else {
+        QDBusContext::sendErrorReply(type, message);
     }
 }
 
+void HostObject::setDelayedReply(bool enable) const
+{
+    if (m_dispatchContext) {
+        m_dispatchContext->delayedReply = enable;
+    } else {
+        QDBusContext::setDelayedReply(enable);
+    }
+}
+
+// Messages are written from the same thread as broadcast signals so they're received in the
+// order they were sent.  Delayed replies and the replies to calls delivered by the
+// HostObjectDispatcher are sent this way so a reply can't overtake the signals emitted while
+// handling its call.  The replies QDBusConnection sends itself for objects registered directly on
+// a connection are written immediately and can arrive before those signals.
+bool HostObject::sendMessage(const QString &connectionName, const QDBusMessage &message)
+{
+    return m_registry
+            ? m_registry->post(connectionName, message)
+            : QDBusConnection(connectionName).send(message);
+}
+
+// Once a connection subscribes to any interface of an object it will only receive the signals of
+// the object's interfaces it has subscribed to, until then it receives all the object's signals.
+void HostObject::subscribe(const QString &interface, bool subscribed)
+{
+    if (m_registry) {
+        m_registry->subscribe(connection().name(), m_registryIndex, interface, subscribed);
+    }
+}
+
+// The pid of a connection is the one captured when it was authenticated, the process it
+// identifies is checked to still be running only when an authorization decision is made on it.
 unsigned long HostObject::connectionPid(const QDBusConnection &connection)
 {
+    if (const auto registry = ConnectionRegistry::instance()) {
+        if (const auto credentials = registry->credentials(connection.name())) {
+            return credentials->pid;
+        }
+    }
+
     unsigned long pid = 0;
     if (dbus_connection_get_unix_process_id(
                 static_cast<DBusConnection *>(connection.internalPointer()), &pid)) {
@@ -139,8 +273,34 @@ unsigned long HostObject::connectionPid(const QDBusConnection &connection)
     }
 }
 
+// If the process which connected has exited and its pid been reused by another process no pid
+// is returned and the caller is denied.
+unsigned long HostObject::verifiedConnectionPid(const QDBusConnection &connection)
+{
+    if (const auto registry = ConnectionRegistry::instance()) {
+        if (const auto credentials = registry->credentials(connection.name())) {
+            if (credentials->isCurrent()) {
+                return credentials->pid;
+            }
+
+            qCWarning(daemon, "Process %lu of connection %s is no longer running",
+                        credentials->pid, qPrintable(connection.name()));
+
+            return 0;
+        }
+    }
+
+    return connectionPid(connection);
+}
+
 unsigned long HostObject::connectionUid(const QDBusConnection &connection)
 {
+    if (const auto registry = ConnectionRegistry::instance()) {
+        if (const auto credentials = registry->credentials(connection.name())) {
+            return credentials->uid;
+        }
+    }
+
     unsigned long uid = -1;
     if (dbus_connection_get_unix_user(
                 static_cast<DBusConnection *>(connection.internalPointer()), &uid)) {
@@ -164,7 +324,7 @@ bool HostObject::isActiveClient(const QString &connection, const QString &addres
 
 bool HostObject::isActiveClient(const QString &client) const
 {
-    return isActiveClient(QDBusContext::connection().name(), QDBusContext::message().service(), client);
+    return isActiveClient(HostObject::connection().name(), HostObject::message().service(), client);
 }
 
 void HostObject::setActiveClient(const QString &connection, const QString &address, const QString &client)
@@ -176,7 +336,7 @@ void HostObject::setActiveClient(const QString &connection, const QString &addre
 
 void HostObject::setActiveClient(const QString &client)
 {
-    setActiveClient(QDBusContext::connection().name(), QDBusContext::message().service(), client);
+    setActiveClient(HostObject::connection().name(), HostObject::message().service(), client);
 }
 
 void HostObject::clearActiveClient()
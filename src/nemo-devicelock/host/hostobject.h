@@ -33,8 +33,12 @@
 #ifndef NEMODEVICELOCK_HOSTOBJECT_H
 #define NEMODEVICELOCK_HOSTOBJECT_H
 
+#include <QDBusAbstractAdaptor>
 #include <QDBusContext>
+#include <QDBusMessage>
+#include <QHash>
 #include <QLoggingCategory>
+#include <QVariantMap>
 
 #include <nemo-dbus/connection.h>
 
@@ -45,6 +49,25 @@ Q_DECLARE_LOGGING_CATEGORY(daemon)
 
 NemoDBus::Connection systemBus();
 
+class ConnectionRegistry;
+class HostObjectDispatcher;
+
+class HostObject;
+class HostSubscriptionAdaptor : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.nemomobile.devicelock.Subscription")
+public:
+    explicit HostSubscriptionAdaptor(HostObject *object);
+
+public slots:
+    void Subscribe(const QString &interface);
+    void Unsubscribe(const QString &interface);
+
+private:
+    HostObject * const m_object;
+};
+
 class HostObject : public QObject, protected QDBusContext
 {
     Q_OBJECT
@@ -62,6 +85,7 @@ public:
     virtual void cancel();
 
     static unsigned long connectionPid(const QDBusConnection &connection);
+    static unsigned long verifiedConnectionPid(const QDBusConnection &connection);
     static unsigned long connectionUid(const QDBusConnection &connection);
 
     virtual bool authorizeConnection(const QDBusConnection &connection);
@@ -73,26 +97,64 @@ public:
     void clearActiveClient();
 
 protected:
+    // The context of the D-Bus call being handled.  These are equivalent to the QDBusContext
+    // functions but also apply to calls delivered by the HostObjectDispatcher.
+    QDBusConnection connection() const;
+    const QDBusMessage &message() const;
+    void sendErrorReply(QDBusError::ErrorType type, const QString &message = QString()) const;
+    void setDelayedReply(bool enable) const;
+
+    bool propertyChangesCoalesced() const;
+    void setPropertyChangesCoalesced(bool coalesced);
+
     void propertyChanged(const QString &interface, const QString &property, const QVariant &value);
     void broadcastSignal(const QString &interface, const QString &name, const QVariantList &arguments);
 
+    bool sendMessage(const QString &connectionName, const QDBusMessage &message);
+
     template <typename... Arguments> inline bool sendToActiveClient(
                 const QString &interface,
                 const QString &method,
                 Arguments... arguments)
     {
         if (!m_activeConnection.isEmpty()) {
+            flushPropertyChanges();
+
             QDBusMessage message = QDBusMessage::createMethodCall(m_activeAddress, m_activeClient, interface, method);
             message.setArguments(NemoDBus::marshallArguments(arguments...));
-            return QDBusConnection(m_activeConnection).send(message);
+            return sendMessage(m_activeConnection, message);
         } else {
             return false;
         }
     }
 
+private slots:
+    void flushPropertyChanges();
+
 private:
+    friend class ConnectionRegistry;
+    friend class HostObjectDispatcher;
+    friend class HostSubscriptionAdaptor;
+
+    struct DispatchContext
+    {
+        DispatchContext(const QDBusConnection &connection, const QDBusMessage &message)
+            : connection(connection), message(message), delayedReply(false) {}
+
+        QDBusConnection connection;
+        const QDBusMessage &message;
+        bool delayedReply;
+    };
+
+    inline void subscribe(const QString &interface, bool subscribed);
+
+    HostSubscriptionAdaptor m_subscriptionAdaptor;
     const QString m_path;
-    QStringList m_connections;
+    QHash<QString, QVariantMap> m_changedProperties;
+    DispatchContext *m_dispatchContext;
+    ConnectionRegistry *m_registry;
+    int m_registryIndex;
+    bool m_coalescePropertyChanges;
     QString m_activeConnection;
     QString m_activeAddress;
     QString m_activeClient;
@@ -0,0 +1,407 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "hostobjectdispatcher.h"
+
+#include "connectionregistry.h"
+#include "hostobject.h"
+
+#include <QDBusAbstractAdaptor>
+#include <QDBusArgument>
+#include <QDBusMetaType>
+#include <QDBusVariant>
+#include <QMetaMethod>
+#include <QSet>
+
+namespace NemoDeviceLock
+{
+
+static const auto propertiesInterface = QStringLiteral("org.freedesktop.DBus.Properties");
+static const auto introspectableInterface = QStringLiteral("org.freedesktop.DBus.Introspectable");
+static const auto peerInterface = QStringLiteral("org.freedesktop.DBus.Peer");
+
+// QMetaMethod::invoke() accepts at most ten arguments.
+static const int maximumArguments = 10;
+
+HostObjectDispatcher::HostObjectDispatcher(
+        ConnectionRegistry *registry, const QVector<HostObject *> &objects, QObject *parent)
+    : QDBusVirtualObject(parent)
+    , m_registry(registry)
+{
+    for (const auto object : objects) {
+        m_objects.insert(object->path(), object);
+    }
+}
+
+HostObjectDispatcher::~HostObjectDispatcher()
+{
+}
+
+QString HostObjectDispatcher::introspect(const QString &path) const
+{
+    QString xml;
+
+    if (const auto object = m_objects.value(path)) {
+        for (const auto adaptor : adaptors(object)) {
+            xml += introspectionXml(adaptor);
+        }
+    }
+
+    const QString prefix = path.endsWith(QLatin1Char('/')) ? path : path + QLatin1Char('/');
+
+    QSet<QString> children;
+    for (auto it = m_objects.constBegin(); it != m_objects.constEnd(); ++it) {
+        if (it.key().startsWith(prefix)) {
+            const auto child = it.key().mid(prefix.length()).section(QLatin1Char('/'), 0, 0);
+            if (!children.contains(child)) {
+                children.insert(child);
+                xml += QStringLiteral("  <node name=\"%1\"/>\n").arg(child);
+            }
+        }
+    }
+
+    return xml;
+}
+
+bool HostObjectDispatcher::handleMessage(const QDBusMessage &message, const QDBusConnection &connection)
+{
+    const auto interface = message.interface();
+
+    if (message.type() != QDBusMessage::MethodCallMessage
+            || interface == introspectableInterface
+            || interface == peerInterface) {
+        // Let the connection handle introspection and pings.
+        return false;
+    }
+
+    const auto object = authorizedObject(message.path(), connection);
+    if (!object) {
+        return false;
+    } else if (interface == propertiesInterface) {
+        return handlePropertiesCall(object, message, connection);
+    }
+
+    for (const auto adaptor : adaptors(object)) {
+        if ((interface.isEmpty() || interfaceName(adaptor) == interface)
+                && handleMethodCall(object, adaptor, message, connection)) {
+            return true;
+        }
+    }
+
+    reply(connection, message.createErrorReply(
+                QDBusError::UnknownMethod,
+                QStringLiteral("No method %1 in interface %2 of object %3").arg(
+                    message.member(), interface, message.path())));
+
+    return true;
+}
+
+HostObject *HostObjectDispatcher::authorizedObject(const QString &path, const QDBusConnection &connection)
+{
+    const auto object = m_objects.value(path);
+    if (!object) {
+        return nullptr;
+    }
+
+    const auto connectionName = connection.name();
+    const int index = object->m_registryIndex;
+
+    if (!m_registry->isAuthorizationChecked(connectionName, index)) {
+        m_registry->setAuthorizationChecked(connectionName, index);
+
+        if (object->authorizeConnection(connection)) {
+            object->clientConnected(connectionName);
+        }
+    }
+
+    return m_registry->isMember(connectionName, index) ? object : nullptr;
+}
+
+bool HostObjectDispatcher::handlePropertiesCall(
+        HostObject *object, const QDBusMessage &message, const QDBusConnection &connection)
+{
+    const auto arguments = message.arguments();
+    const auto adaptor = HostObjectDispatcher::adaptor(object, arguments.value(0).toString());
+    const auto member = message.member();
+
+    if (!adaptor) {
+        reply(connection, message.createErrorReply(
+                    QDBusError::UnknownInterface,
+                    QStringLiteral("No interface %1 on object %2").arg(
+                        arguments.value(0).toString(), message.path())));
+        return true;
+    }
+
+    const QMetaObject * const metaObject = adaptor->metaObject();
+    const int propertyOffset = QDBusAbstractAdaptor::staticMetaObject.propertyCount();
+
+    if (member == QLatin1String("Get") && arguments.count() == 2) {
+        const int index = metaObject->indexOfProperty(arguments.at(1).toString().toLatin1());
+
+        if (index < propertyOffset) {
+            reply(connection, message.createErrorReply(
+                        QDBusError::InvalidArgs,
+                        QStringLiteral("No property %1").arg(arguments.at(1).toString())));
+        } else {
+            reply(connection, message.createReply(QVariant::fromValue(
+                        QDBusVariant(metaObject->property(index).read(adaptor)))));
+        }
+    } else if (member == QLatin1String("GetAll") && arguments.count() == 1) {
+        QVariantMap properties;
+
+        for (int i = propertyOffset; i < metaObject->propertyCount(); ++i) {
+            const auto property = metaObject->property(i);
+            if (property.isReadable()) {
+                properties.insert(QString::fromLatin1(property.name()), property.read(adaptor));
+            }
+        }
+
+        reply(connection, message.createReply(properties));
+    } else {
+        // None of the properties published by the daemon are writable.
+        reply(connection, message.createErrorReply(QDBusError::NotSupported, QString()));
+    }
+
+    return true;
+}
+
+// Finds a public slot of an adaptor matching the name and arguments of a call and invokes it.
+bool HostObjectDispatcher::handleMethodCall(
+        HostObject *object,
+        QDBusAbstractAdaptor *adaptor,
+        const QDBusMessage &message,
+        const QDBusConnection &connection)
+{
+    const QMetaObject * const metaObject = adaptor->metaObject();
+    const QByteArray member = message.member().toLatin1();
+    const auto arguments = message.arguments();
+
+    for (int i = QDBusAbstractAdaptor::staticMetaObject.methodCount(); i < metaObject->methodCount(); ++i) {
+        const auto method = metaObject->method(i);
+
+        if (method.methodType() != QMetaMethod::Slot
+                || method.access() != QMetaMethod::Public
+                || method.name() != member
+                || method.parameterCount() != arguments.count()
+                || method.parameterCount() > maximumArguments) {
+            continue;
+        }
+
+        QVariantList parameters;
+        for (int j = 0; j < arguments.count(); ++j) {
+            const auto &argument = arguments.at(j);
+            const int type = method.parameterType(j);
+
+            if (argument.userType() == type) {
+                parameters.append(argument);
+            } else if (argument.userType() == qMetaTypeId<QDBusArgument>()) {
+                QVariant parameter(type, nullptr);
+                if (QDBusMetaType::demarshall(qvariant_cast<QDBusArgument>(argument), type, parameter.data())) {
+                    parameters.append(parameter);
+                } else {
+                    break;
+                }
+            } else {
+                break;
+            }
+        }
+
+        if (parameters.count() == arguments.count()) {
+            invoke(object, adaptor, method, parameters, message, connection);
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void HostObjectDispatcher::invoke(
+        HostObject *object,
+        QDBusAbstractAdaptor *adaptor,
+        const QMetaMethod &method,
+        const QVariantList &arguments,
+        const QDBusMessage &message,
+        const QDBusConnection &connection)
+{
+    QGenericArgument genericArguments[maximumArguments];
+    for (int i = 0; i < arguments.count(); ++i) {
+        genericArguments[i] = QGenericArgument(arguments.at(i).typeName(), arguments.at(i).constData());
+    }
+
+    QVariant result;
+    QGenericReturnArgument returnArgument;
+    if (method.returnType() != QMetaType::Void) {
+        result = QVariant(method.returnType(), nullptr);
+        returnArgument = QGenericReturnArgument(method.typeName(), result.data());
+    }
+
+    HostObject::DispatchContext context(connection, message);
+    const auto previousContext = object->m_dispatchContext;
+    object->m_dispatchContext = &context;
+
+    const bool invoked = method.invoke(
+                adaptor,
+                Qt::DirectConnection,
+                returnArgument,
+                genericArguments[0],
+                genericArguments[1],
+                genericArguments[2],
+                genericArguments[3],
+                genericArguments[4],
+                genericArguments[5],
+                genericArguments[6],
+                genericArguments[7],
+                genericArguments[8],
+                genericArguments[9]);
+
+    object->m_dispatchContext = previousContext;
+
+    if (!invoked) {
+        qCWarning(daemon, "Failed to invoke %s on %s",
+                    method.methodSignature().constData(), qPrintable(message.path()));
+
+        reply(connection, message.createErrorReply(QDBusError::InternalError, QString()));
+    } else if (!context.delayedReply && message.isReplyRequired()) {
+        reply(connection, result.isValid() ? message.createReply(result) : message.createReply());
+    }
+}
+
+// Replies are written by the same thread as signals so a reply can't overtake the signals emitted
+// while handling its call.
+void HostObjectDispatcher::reply(const QDBusConnection &connection, const QDBusMessage &message)
+{
+    m_registry->post(connection.name(), message);
+}
+
+QVector<QDBusAbstractAdaptor *> HostObjectDispatcher::adaptors(const HostObject *object)
+{
+    return object->findChildren<QDBusAbstractAdaptor *>(QString(), Qt::FindDirectChildrenOnly).toVector();
+}
+
+QString HostObjectDispatcher::interfaceName(const QDBusAbstractAdaptor *adaptor)
+{
+    const QMetaObject * const metaObject = adaptor->metaObject();
+    const int index = metaObject->indexOfClassInfo("D-Bus Interface");
+
+    return index >= 0 ? QString::fromLatin1(metaObject->classInfo(index).value()) : QString();
+}
+
+static QString argumentXml(int type, const QByteArray &name, const char *direction)
+{
+    QString xml = QStringLiteral("      <arg type=\"%1\"").arg(
+                QString::fromLatin1(QDBusMetaType::typeToSignature(type)));
+    if (!name.isEmpty()) {
+        xml += QStringLiteral(" name=\"%1\"").arg(QString::fromLatin1(name));
+    }
+    if (direction) {
+        xml += QStringLiteral(" direction=\"%1\"").arg(QLatin1String(direction));
+    }
+    return xml + QStringLiteral("/>\n");
+}
+
+// Whether every argument of a method can be expressed as a D-Bus type.
+static bool isExportable(const QMetaMethod &method)
+{
+    if (method.returnType() != QMetaType::Void && !QDBusMetaType::typeToSignature(method.returnType())) {
+        return false;
+    }
+    for (int i = 0; i < method.parameterCount(); ++i) {
+        if (!QDBusMetaType::typeToSignature(method.parameterType(i))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The introspection data of an adaptor.  This is the "D-Bus Introspection" class info if the
+// adaptor has it, otherwise it's generated from the public slots, signals and properties the
+// adaptor exports as QDBusConnection would for a registered object.
+QString HostObjectDispatcher::introspectionXml(const QDBusAbstractAdaptor *adaptor)
+{
+    const QMetaObject * const metaObject = adaptor->metaObject();
+
+    const int introspectionIndex = metaObject->indexOfClassInfo("D-Bus Introspection");
+    if (introspectionIndex >= 0) {
+        return QString::fromUtf8(metaObject->classInfo(introspectionIndex).value());
+    }
+
+    QString xml = QStringLiteral("  <interface name=\"%1\">\n").arg(interfaceName(adaptor));
+
+    for (int i = QDBusAbstractAdaptor::staticMetaObject.propertyCount(); i < metaObject->propertyCount(); ++i) {
+        const auto property = metaObject->property(i);
+        const char * const signature = QDBusMetaType::typeToSignature(property.userType());
+
+        if (property.isReadable() && signature) {
+            xml += QStringLiteral("    <property name=\"%1\" type=\"%2\" access=\"read\"/>\n").arg(
+                        QString::fromLatin1(property.name()), QString::fromLatin1(signature));
+        }
+    }
+
+    for (int i = QDBusAbstractAdaptor::staticMetaObject.methodCount(); i < metaObject->methodCount(); ++i) {
+        const auto method = metaObject->method(i);
+        const auto names = method.parameterNames();
+
+        if (method.access() != QMetaMethod::Public || !isExportable(method)) {
+            continue;
+        } else if (method.methodType() == QMetaMethod::Signal) {
+            xml += QStringLiteral("    <signal name=\"%1\">\n").arg(QString::fromLatin1(method.name()));
+            for (int j = 0; j < method.parameterCount(); ++j) {
+                xml += argumentXml(method.parameterType(j), names.value(j), nullptr);
+            }
+            xml += QStringLiteral("    </signal>\n");
+        } else if (method.methodType() == QMetaMethod::Slot) {
+            xml += QStringLiteral("    <method name=\"%1\">\n").arg(QString::fromLatin1(method.name()));
+            for (int j = 0; j < method.parameterCount(); ++j) {
+                xml += argumentXml(method.parameterType(j), names.value(j), "in");
+            }
+            if (method.returnType() != QMetaType::Void) {
+                xml += argumentXml(method.returnType(), QByteArray(), "out");
+            }
+            xml += QStringLiteral("    </method>\n");
+        }
+    }
+
+    return xml + QStringLiteral("  </interface>\n");
+}
+
+QDBusAbstractAdaptor *HostObjectDispatcher::adaptor(const HostObject *object, const QString &interface)
+{
+    for (const auto adaptor : adaptors(object)) {
+        if (interfaceName(adaptor) == interface) {
+            return adaptor;
+        }
+    }
+    return nullptr;
+}
+
+}
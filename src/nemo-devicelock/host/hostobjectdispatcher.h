@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef NEMODEVICELOCK_HOSTOBJECTDISPATCHER_H
+#define NEMODEVICELOCK_HOSTOBJECTDISPATCHER_H
+
+#include <QDBusVirtualObject>
+#include <QHash>
+#include <QVector>
+
+QT_BEGIN_NAMESPACE
+class QDBusAbstractAdaptor;
+class QMetaMethod;
+QT_END_NAMESPACE
+
+namespace NemoDeviceLock
+{
+
+class ConnectionRegistry;
+class HostObject;
+
+// Handles every path on a peer to peer connection and delivers calls to the adaptors of the
+// host object at the path of a message.  A connection is only authorized for an object and
+// subscribed to its signals when it first calls that object, so accepting a connection doesn't
+// require registering every object on it.
+class HostObjectDispatcher : public QDBusVirtualObject
+{
+    Q_OBJECT
+public:
+    HostObjectDispatcher(
+            ConnectionRegistry *registry,
+            const QVector<HostObject *> &objects,
+            QObject *parent = nullptr);
+    ~HostObjectDispatcher();
+
+    QString introspect(const QString &path) const override;
+    bool handleMessage(const QDBusMessage &message, const QDBusConnection &connection) override;
+
+private:
+    HostObject *authorizedObject(const QString &path, const QDBusConnection &connection);
+
+    bool handlePropertiesCall(
+            HostObject *object, const QDBusMessage &message, const QDBusConnection &connection);
+    bool handleMethodCall(
+            HostObject *object,
+            QDBusAbstractAdaptor *adaptor,
+            const QDBusMessage &message,
+            const QDBusConnection &connection);
+    void invoke(
+            HostObject *object,
+            QDBusAbstractAdaptor *adaptor,
+            const QMetaMethod &method,
+            const QVariantList &arguments,
+            const QDBusMessage &message,
+            const QDBusConnection &connection);
+
+    void reply(const QDBusConnection &connection, const QDBusMessage &message);
+
+    static QVector<QDBusAbstractAdaptor *> adaptors(const HostObject *object);
+    static QString interfaceName(const QDBusAbstractAdaptor *adaptor);
+    static QString introspectionXml(const QDBusAbstractAdaptor *adaptor);
+    static QDBusAbstractAdaptor *adaptor(const HostObject *object, const QString &interface);
+
+    ConnectionRegistry * const m_registry;
+    QHash<QString, HostObject *> m_objects;
+};
+
+}
+
+#endif
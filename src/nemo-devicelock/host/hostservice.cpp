@@ -43,7 +43,7 @@
 #include <QDBusConnection>
 #include <QDBusMetaType>
 #include <QDir>
-#include <QThread>
+#include <QElapsedTimer>
 
 #include <dbus/dbus.h>
 #include <systemd/sd-daemon.h>
@@ -51,41 +51,120 @@
 namespace NemoDeviceLock
 {
 
+// The PID and UID of the connecting process can't be acquired until after the connection is
+// authenticated, which is done concurrently to the invokation of the newConnection slot.  libdbus
+// consults the unix user function of a connection when authentication completes, so that's used
+// to learn of it and posts the registration of the connection back to the main thread.  Anonymous
+// authentication isn't reported through the function, and an anonymous peer has no credentials
+// to authorize anyway, so it isn't allowed.
+struct PeerAuthentication
+{
+    HostService *service;
+    QString connectionName;
+};
+
+static dbus_bool_t peerAuthenticated(DBusConnection *, unsigned long, void *data)
+{
+    const auto authentication = static_cast<PeerAuthentication *>(data);
+
+    QMetaObject::invokeMethod(
+                authentication->service,
+                "peerAuthenticated",
+                Qt::QueuedConnection,
+                Q_ARG(QString, authentication->connectionName));
+
+    // Any user may connect, access to each object is decided when the connection is registered.
+    return TRUE;
+}
+
+static void freePeerAuthentication(void *data)
+{
+    delete static_cast<PeerAuthentication *>(data);
+}
+
 class ConnectionMonitor : public QObject
 {
     Q_OBJECT
 public:
-    ConnectionMonitor(HostService *service, const QString &connectionName)
+    ConnectionMonitor(HostService *service, const QDBusConnection &connection)
         : QObject(service)
         , m_service(service)
-        , m_connectionName(connectionName)
+        , m_connection(connection)
+        , m_connectionName(connection.name())
+        , m_authenticated(false)
+        , m_disconnected(false)
     {
+        m_elapsed.start();
     }
 
 public slots:
+    // Registers the connection once it's authenticated.  This is called both when the connection
+    // is accepted and when libdbus reports it has been authenticated, whichever finds it
+    // authenticated first registers it.
+    void authenticate()
+    {
+        auto internalConnection = static_cast<DBusConnection *>(m_connection.internalPointer());
+
+        if (m_authenticated || m_disconnected) {
+            // Already handled.
+        } else if (!dbus_connection_get_is_connected(internalConnection)) {
+            // disconnected() will follow.
+        } else if (!dbus_connection_get_is_authenticated(internalConnection)) {
+            // peerAuthenticated() will follow.
+        } else {
+            m_authenticated = true;
+            m_service->connectionAuthenticated(m_connection, m_elapsed.nsecsElapsed() / 1000);
+        }
+    }
+
     void disconnected()
     {
+        if (m_disconnected) {
+            return;
+        }
+
+        m_disconnected = true;
+
         deleteLater();
 
+        QElapsedTimer elapsed;
+        elapsed.start();
+
         for (const auto object : m_service->m_objects) {
             object->clientDisconnected(m_connectionName);
         }
 
         QDBusConnection::disconnectFromPeer(m_connectionName);
+
+        m_service->connectionDisconnected(m_connectionName, m_authenticated, elapsed.nsecsElapsed() / 1000);
     }
 
 private:
     HostService * const m_service;
+    QDBusConnection m_connection;
     const QString m_connectionName;
+    QElapsedTimer m_elapsed;
+    bool m_authenticated;
+    bool m_disconnected;
 };
 
 HostService::HostService(const QVector<HostObject *> objects, QObject *parent)
     : QDBusServer(HostService::socketAddress(), parent)
     , m_objects(objects)
+    , m_dispatcher(&m_registry, objects)
+    , m_connectionCount(0)
+    , m_peakConnectionCount(0)
+    , m_acceptedConnectionCount(0)
+    , m_unauthenticatedConnectionCount(0)
+    , m_evictedConnectionCount(0)
+    , m_lazyRegistration(false)
 {
-    setAnonymousAuthenticationAllowed(true);
+    for (const auto object : m_objects) {
+        m_registry.addObject(object);
+    }
 
     connect(this, &QDBusServer::newConnection, this, &HostService::connectionReady);
+    connect(m_registry.writer(), &PeerWriter::connectionStalled, this, &HostService::connectionStalled);
 
     qDBusRegisterMetaType<NemoDeviceLock::Fingerprint>();
     qDBusRegisterMetaType<QVector<NemoDeviceLock::Fingerprint>>();
@@ -149,7 +228,12 @@ void HostService::connectionReady(const QDBusConnection &newConnection)
 
     QDBusConnection connection(newConnection);
 
-    const auto monitor = new ConnectionMonitor(this, connection.name());
+    ++m_acceptedConnectionCount;
+    ++m_unauthenticatedConnectionCount;
+    m_peakConnectionCount = qMax(m_peakConnectionCount, ++m_connectionCount);
+
+    const auto monitor = new ConnectionMonitor(this, connection);
+    m_monitors.insert(connection.name(), monitor);
 
     if (!connection.connect(
                 QString(),
@@ -158,33 +242,140 @@ void HostService::connectionReady(const QDBusConnection &newConnection)
                 QStringLiteral("Disconnected"),
                 monitor,
                 SLOT(disconnected()))) {
+        qCWarning(daemon, "Failed to connect to disconnect signal, dropping connection %s",
+                    qPrintable(connection.name()));
+
+        // Without the signal nothing would release the connection's state when it goes away.
+        m_monitors.remove(connection.name());
         delete monitor;
 
-        qCWarning(daemon, "Failed to connect to disconnect signal");
+        --m_connectionCount;
+        --m_unauthenticatedConnectionCount;
+
+        QDBusConnection::disconnectFromPeer(connection.name());
+
+        return;
     }
 
-    // The PID and UID of the connecting process can't be acquired until after the connection
-    // is authenticated which is done concurrently to the invokation of this slot.  Block until
-    // the connection is authenticated or disconnected before trying to decide which services
-    // a process should have access to.
-    auto internalConnection = static_cast<DBusConnection *>(connection.internalPointer());
-    while (dbus_connection_get_is_connected(internalConnection)
-           && !dbus_connection_get_is_authenticated(internalConnection)) {
-        QThread::usleep(100);
+    // The function must be in place before the state is first checked or a connection which is
+    // authenticated in between would be missed.
+    dbus_connection_set_unix_user_function(
+                static_cast<DBusConnection *>(connection.internalPointer()),
+                peerAuthenticated,
+                new PeerAuthentication { this, connection.name() },
+                freePeerAuthentication);
+
+    monitor->authenticate();
+}
+
+void HostService::peerAuthenticated(const QString &connectionName)
+{
+    if (const auto monitor = m_monitors.value(connectionName)) {
+        monitor->authenticate();
     }
+}
+
+void HostService::connectionAuthenticated(const QDBusConnection &authenticatedConnection, qint64 elapsed)
+{
+    QDBusConnection connection(authenticatedConnection);
 
     const auto connectionName = connection.name();
 
-    for (const auto object : m_objects) {
+    QElapsedTimer stall;
+    stall.start();
+
+    // Capture the credentials of the peer once for all the objects.
+    m_registry.insert(connection);
+
+    if (m_lazyRegistration) {
+        // The dispatcher authorizes the connection for each object on its first call.
+        if (!connection.registerVirtualObject(
+                    QStringLiteral("/"), &m_dispatcher, QDBusConnection::SubPath)) {
+            qCWarning(daemon, "Failed to register object dispatcher on connection %s",
+                        qPrintable(connectionName));
+        }
+    } else for (const auto object : m_objects) {
         if (object->authorizeConnection(connection)) {
             registerObject(connection, object->path(), object);
             object->clientConnected(connectionName);
         }
     }
+
+    --m_unauthenticatedConnectionCount;
+
+    m_registrationStall.record(stall.nsecsElapsed() / 1000);
+    m_registrationLatency.record(elapsed);
+
+    qCDebug(daemon, "Registered connection %s after %lldus", qPrintable(connectionName), elapsed);
+}
+
+void HostService::connectionDisconnected(const QString &connectionName, bool authenticated, qint64 stall)
+{
+    m_registry.remove(connectionName);
+    m_monitors.remove(connectionName);
+
+    --m_connectionCount;
+    if (!authenticated) {
+        --m_unauthenticatedConnectionCount;
+    }
+
+    m_disconnectionStall.record(stall);
+}
+
+bool HostService::lazyRegistration() const
+{
+    return m_lazyRegistration;
+}
+
+// Instead of registering every object on a new connection register a single dispatcher which
+// delivers calls to objects on demand.  A client will only receive the signals of objects it
+// has called.
+void HostService::setLazyRegistration(bool lazy)
+{
+    m_lazyRegistration = lazy;
+}
+
+// A client which has stopped reading from its connection is disconnected rather than
+// letting messages for it accumulate indefinitely.
+void HostService::connectionStalled(const QString &connectionName)
+{
+    if (const auto monitor = m_monitors.value(connectionName)) {
+        qCWarning(daemon, "Disconnecting connection %s which has stopped reading messages",
+                    qPrintable(connectionName));
+
+        ++m_evictedConnectionCount;
+
+        monitor->disconnected();
+    }
+}
+
+// Durations are in microseconds.  The stall times are how long the event loop was blocked
+// handling a connection or disconnection.
+QVariantMap HostService::statistics() const
+{
+    return {
+        { QStringLiteral("connections"), m_connectionCount },
+        { QStringLiteral("registeredConnections"), m_registry.count() },
+        { QStringLiteral("broadcast"), m_registry.broadcastStatistics() },
+        { QStringLiteral("peakConnections"), m_peakConnectionCount },
+        { QStringLiteral("acceptedConnections"), m_acceptedConnectionCount },
+        { QStringLiteral("unauthenticatedConnections"), m_unauthenticatedConnectionCount },
+        { QStringLiteral("evictedConnections"), m_evictedConnectionCount },
+        { QStringLiteral("registration"), m_registrationLatency.toMap() },
+        { QStringLiteral("registrationStall"), m_registrationStall.toMap() },
+        { QStringLiteral("disconnectionStall"), m_disconnectionStall.toMap() }
+    };
 }
 
 QString HostService::socketAddress()
 {
+    // An alternative address can be given to run a second instance alongside the system daemon,
+    // i.e. for benchmarking.
+    const QByteArray address = qgetenv("NEMODEVICELOCK_ADDRESS");
+    if (!address.isEmpty()) {
+        return QString::fromUtf8(address);
+    }
+
     // Check if socket-based activation logic is enabled and at least one fd is provided
     if (sd_listen_fds(0) > 0)
         return QStringLiteral("systemd:");
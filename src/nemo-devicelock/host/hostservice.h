@@ -33,8 +33,13 @@
 #ifndef NEMODEVICELOCK_HOSTSERVICE_H
 #define NEMODEVICELOCK_HOSTSERVICE_H
 
+#include <nemo-devicelock/host/connectionregistry.h>
+#include <nemo-devicelock/host/hostobjectdispatcher.h>
+#include <nemo-devicelock/host/latencyhistogram.h>
+
 #include <QDBusServer>
 
+#include <QVariantMap>
 #include <QVector>
 
 namespace NemoDeviceLock
@@ -47,6 +52,7 @@ class HostDeviceReset;
 class HostEncryptionSettings;
 class HostFingerprintSensor;
 class HostFingerprintSettings;
+class ConnectionMonitor;
 class HostObject;
 
 class HostService : public QDBusServer
@@ -65,14 +71,37 @@ public:
             QObject *parent = nullptr);
     ~HostService();
 
+    bool lazyRegistration() const;
+    void setLazyRegistration(bool lazy);
+
+    QVariantMap statistics() const;
+
+private slots:
+    void peerAuthenticated(const QString &connectionName);
+
 private:
     friend class ConnectionMonitor;
 
     void connectionReady(const QDBusConnection &connection);
+    void connectionAuthenticated(const QDBusConnection &connection, qint64 elapsed);
+    void connectionDisconnected(const QString &connectionName, bool authenticated, qint64 stall);
+    void connectionStalled(const QString &connectionName);
     static QString socketAddress();
     void nameLost(const QString &name);
 
     const QVector<HostObject *> m_objects;
+    ConnectionRegistry m_registry;
+    HostObjectDispatcher m_dispatcher;
+    QHash<QString, ConnectionMonitor *> m_monitors;
+    LatencyHistogram m_registrationLatency;
+    LatencyHistogram m_registrationStall;
+    LatencyHistogram m_disconnectionStall;
+    int m_connectionCount;
+    int m_peakConnectionCount;
+    int m_acceptedConnectionCount;
+    int m_unauthenticatedConnectionCount;
+    int m_evictedConnectionCount;
+    bool m_lazyRegistration;
 };
 
 }
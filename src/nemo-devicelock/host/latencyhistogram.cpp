@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "latencyhistogram.h"
+
+#include <algorithm>
+
+namespace NemoDeviceLock
+{
+
+static int bucket(qint64 microseconds)
+{
+    int index = 0;
+    while (microseconds > 1 && index < LatencyHistogram::BucketCount - 1) {
+        microseconds >>= 1;
+        ++index;
+    }
+    return index;
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    clear();
+}
+
+void LatencyHistogram::record(qint64 microseconds)
+{
+    microseconds = qMax<qint64>(0, microseconds);
+
+    ++m_buckets[bucket(microseconds)];
+    ++m_count;
+    m_total += microseconds;
+    m_maximum = qMax(m_maximum, microseconds);
+}
+
+void LatencyHistogram::clear()
+{
+    std::fill(m_buckets, m_buckets + BucketCount, 0);
+    m_count = 0;
+    m_total = 0;
+    m_maximum = 0;
+}
+
+int LatencyHistogram::count() const
+{
+    return m_count;
+}
+
+qint64 LatencyHistogram::total() const
+{
+    return m_total;
+}
+
+qint64 LatencyHistogram::maximum() const
+{
+    return m_maximum;
+}
+
+// Returns the upper bound of the bucket containing the given percentile, or the maximum recorded
+// duration if that is smaller.
+qint64 LatencyHistogram::percentile(int percent) const
+{
+    if (m_count == 0) {
+        return 0;
+    }
+
+    const int rank = qMax(1, (m_count * qBound(0, percent, 100) + 99) / 100);
+
+    int accumulated = 0;
+    for (int index = 0; index < BucketCount; ++index) {
+        accumulated += m_buckets[index];
+        if (accumulated >= rank) {
+            return qMin(m_maximum, (qint64(1) << (index + 1)) - 1);
+        }
+    }
+
+    return m_maximum;
+}
+
+QVariantMap LatencyHistogram::toMap() const
+{
+    QVariantList buckets;
+    for (int count : m_buckets) {
+        buckets.append(count);
+    }
+
+    return {
+        { QStringLiteral("count"), m_count },
+        { QStringLiteral("total"), m_total },
+        { QStringLiteral("maximum"), m_maximum },
+        { QStringLiteral("p50"), percentile(50) },
+        { QStringLiteral("p95"), percentile(95) },
+        { QStringLiteral("p99"), percentile(99) },
+        { QStringLiteral("buckets"), buckets }
+    };
+}
+
+}
@@ -150,6 +150,10 @@ void MceDeviceLock::handleTklockStateChanged(const QString &state)
 
         m_tklockActive = active;
         setStateAndSetupLockTimer();
+
+        if (m_tklockActive && m_displayOn && m_locked) {
+            unlockAnticipated();
+        }
     }
 }
 
@@ -178,9 +182,22 @@ void MceDeviceLock::handleDisplayStateChanged(const QString &state)
 
         m_displayOn = displayOn;
         setStateAndSetupLockTimer();
+
+        if (m_displayOn && m_locked) {
+            unlockAnticipated();
+        }
     }
 }
 
+/** Called when the display turns on while the device is locked
+ *
+ * The user is likely to start entering their security code shortly,
+ * an implementation can use this to prepare for the unlock attempt.
+ */
+void MceDeviceLock::unlockAnticipated()
+{
+}
+
 /** Handle inactivity state signal/reply from mce
  */
 void MceDeviceLock::handleInactivityStateChanged(const bool state)
@@ -93,6 +93,8 @@ protected:
     void automaticLockingChanged() override;
     void stateChanged() override;
 
+    virtual void unlockAnticipated();
+
 protected slots:
     void lock();
 
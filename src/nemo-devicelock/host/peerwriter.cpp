@@ -0,0 +1,369 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "peerwriter.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <climits>
+
+#include <dbus/dbus.h>
+
+namespace NemoDeviceLock
+{
+
+// Whether a message reports the current value of every property reported by an earlier message.
+// The keys of a message are sorted.
+static bool supersedes(const QStringList &keys, const QStringList &earlierKeys)
+{
+    return std::includes(keys.begin(), keys.end(), earlierKeys.begin(), earlierKeys.end());
+}
+
+PeerWriter::PeerWriter(QObject *parent)
+    : QThread(parent)
+    , m_congestedCount(0)
+    , m_writtenCount(0)
+    , m_supersededCount(0)
+    , m_droppedCount(0)
+    , m_failedCount(0)
+    , m_stalledCount(0)
+    , m_peakQueued(0)
+    , m_stopping(false)
+{
+    m_clock.start();
+
+    start();
+}
+
+PeerWriter::~PeerWriter()
+{
+    stop();
+
+    for (const auto &message : m_queue) {
+        release(message);
+    }
+    for (const auto &peer : m_peers) {
+        for (const auto &message : peer.deferred) {
+            release(message);
+        }
+    }
+}
+
+// Posts a message to a connection.  If there is an encoded message each connection is written
+// a copy of it so it can be shared between many connections, otherwise the message is sent
+// through QDBusConnection.  The coalesce keys of a message identify the properties it reports the
+// value of, a congested connection only needs to be delivered the latest value of each.  Only
+// such messages are dropped when too many are queued for a connection, a lost reply would leave
+// a client waiting on a call.
+bool PeerWriter::post(
+        DBusConnection *connection,
+        const QString &connectionName,
+        DBusMessage *encodedMessage,
+        const QDBusMessage &message,
+        const QStringList &coalesceKeys)
+{
+    QMutexLocker locker(&m_mutex);
+
+    Peer &peer = m_peers[connectionName];
+
+    if (m_stopping || (peer.queued >= MaximumQueuedMessages && !coalesceKeys.isEmpty())) {
+        ++m_droppedCount;
+
+        return false;
+    }
+
+    ++peer.queued;
+
+    Message item;
+    item.connection = connection;
+    item.encodedMessage = encodedMessage;
+    item.connectionName = connectionName;
+    item.message = message;
+    item.coalesceKeys = coalesceKeys;
+    item.postTime = m_clock.nsecsElapsed();
+
+    if (item.connection) {
+        dbus_connection_ref(item.connection);
+    }
+    if (item.encodedMessage) {
+        dbus_message_ref(item.encodedMessage);
+    }
+
+    m_queue.enqueue(item);
+    m_peakQueued = qMax(m_peakQueued, m_queue.count());
+
+    m_condition.wakeOne();
+
+    return true;
+}
+
+// Discards any messages waiting to be written to a connection which has been disconnected.
+void PeerWriter::discard(const QString &connectionName)
+{
+    QMutexLocker locker(&m_mutex);
+
+    const auto peer = m_peers.find(connectionName);
+    if (peer == m_peers.end()) {
+        return;
+    }
+
+    for (const auto &message : peer.value().deferred) {
+        release(message);
+    }
+
+    if (peer.value().queued > 0) {
+        for (auto it = m_queue.begin(); it != m_queue.end(); ) {
+            if (it->connectionName == connectionName) {
+                release(*it);
+                it = m_queue.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    m_peers.erase(peer);
+}
+
+void PeerWriter::stop()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+
+        m_stopping = true;
+        m_condition.wakeOne();
+    }
+
+    wait();
+}
+
+// Latencies are in microseconds.  The queue latency is the time from a message being posted to
+// it being written.  Superseded messages were deferred while a connection was congested and
+// replaced by a later message, dropped messages exceeded the queue limit and were never written.
+QVariantMap PeerWriter::statistics() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    int congested = 0;
+    for (const auto &peer : m_peers) {
+        if (peer.congested) {
+            ++congested;
+        }
+    }
+
+    return {
+        { QStringLiteral("written"), m_writtenCount },
+        { QStringLiteral("superseded"), m_supersededCount },
+        { QStringLiteral("dropped"), m_droppedCount },
+        { QStringLiteral("failed"), m_failedCount },
+        { QStringLiteral("congestions"), m_congestedCount },
+        { QStringLiteral("congestedConnections"), congested },
+        { QStringLiteral("stalledConnections"), m_stalledCount },
+        { QStringLiteral("queued"), m_queue.count() },
+        { QStringLiteral("peakQueued"), m_peakQueued },
+        { QStringLiteral("queueLatency"), m_queueLatency.toMap() },
+        { QStringLiteral("writeLatency"), m_writeLatency.toMap() }
+    };
+}
+
+void PeerWriter::run()
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (;;) {
+        updateCongestion();
+
+        if (m_queue.isEmpty()) {
+            if (m_stopping) {
+                return;
+            }
+
+            bool congested = false;
+            for (const auto &peer : m_peers) {
+                congested |= peer.congested;
+            }
+
+            // The buffers of congested connections are drained by Qt's connection thread without
+            // any notification, so poll until they're no longer congested.
+            m_condition.wait(&m_mutex, congested ? CongestionPollInterval : ULONG_MAX);
+
+            continue;
+        }
+
+        const Message message = m_queue.dequeue();
+
+        const auto peer = m_peers.find(message.connectionName);
+        if (peer != m_peers.end()) {
+            --peer.value().queued;
+        }
+
+        if (dispose(message) == Defer) {
+            continue;
+        }
+
+        locker.unlock();
+
+        const qint64 startTime = m_clock.nsecsElapsed();
+        const bool written = write(message);
+        const qint64 endTime = m_clock.nsecsElapsed();
+
+        release(message);
+
+        locker.relock();
+
+        if (written) {
+            ++m_writtenCount;
+        } else {
+            ++m_failedCount;
+        }
+
+        m_queueLatency.record((endTime - message.postTime) / 1000);
+        m_writeLatency.record((endTime - startTime) / 1000);
+    }
+}
+
+// Decides whether a message can be written to its connection immediately.  Called with the
+// mutex locked.
+PeerWriter::Disposition PeerWriter::dispose(const Message &message)
+{
+    if (!message.connection) {
+        return Write;
+    }
+
+    const long outgoing = dbus_connection_get_outgoing_size(message.connection);
+
+    auto &peer = m_peers[message.connectionName];
+
+    if (!peer.congested && outgoing > HighWatermark) {
+        peer.congested = true;
+        peer.congestedTime = m_clock.elapsed();
+
+        ++m_congestedCount;
+    }
+
+    if (peer.congested && !message.coalesceKeys.isEmpty()) {
+        for (auto it = peer.deferred.begin(); it != peer.deferred.end(); ) {
+            if (supersedes(message.coalesceKeys, it->coalesceKeys)) {
+                release(*it);
+                it = peer.deferred.erase(it);
+
+                ++m_supersededCount;
+            } else {
+                ++it;
+            }
+        }
+
+        peer.deferred.append(message);
+
+        return Defer;
+    } else {
+        return Write;
+    }
+}
+
+// Returns the deferred messages of connections which are no longer congested to the front of the
+// queue, they were posted before anything still queued for the connection.  Reports connections
+// which have been congested for too long.  Called with the mutex locked.
+void PeerWriter::updateCongestion()
+{
+    for (auto it = m_peers.begin(); it != m_peers.end(); ++it) {
+        Peer &peer = it.value();
+
+        if (!peer.congested) {
+            continue;
+        }
+
+        DBusConnection *connection = nullptr;
+        if (!peer.deferred.isEmpty()) {
+            connection = peer.deferred.first().connection;
+        } else {
+            for (const auto &message : m_queue) {
+                if (message.connectionName == it.key() && message.connection) {
+                    connection = message.connection;
+                    break;
+                }
+            }
+        }
+
+        if (!connection || dbus_connection_get_outgoing_size(connection) < LowWatermark) {
+            peer.congested = false;
+            peer.stalled = false;
+
+            for (int i = peer.deferred.count() - 1; i >= 0; --i) {
+                m_queue.prepend(peer.deferred.at(i));
+                ++peer.queued;
+            }
+            peer.deferred.clear();
+        } else if (!peer.stalled && m_clock.elapsed() - peer.congestedTime > EvictionTimeout) {
+            peer.stalled = true;
+
+            ++m_stalledCount;
+
+            emit connectionStalled(it.key());
+        }
+    }
+}
+
+bool PeerWriter::write(const Message &message)
+{
+    if (!message.encodedMessage) {
+        return QDBusConnection(message.connectionName).send(message.message);
+    } else if (!dbus_connection_get_is_connected(message.connection)) {
+        return false;
+    }
+
+    // Each connection assigns its own serial to an outgoing message so every peer gets a copy,
+    // copying the message duplicates the encoded buffer without marshalling the arguments again.
+    DBusMessage * const copy = dbus_message_copy(message.encodedMessage);
+    if (!copy) {
+        return false;
+    }
+
+    const bool sent = dbus_connection_send(message.connection, copy, nullptr);
+
+    dbus_message_unref(copy);
+
+    return sent;
+}
+
+void PeerWriter::release(const Message &message)
+{
+    if (message.connection) {
+        dbus_connection_unref(message.connection);
+    }
+    if (message.encodedMessage) {
+        dbus_message_unref(message.encodedMessage);
+    }
+}
+
+}
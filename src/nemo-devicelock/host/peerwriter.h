@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2016 Jolla Ltd
+ * Contact: Andrew den Exter <andrew.den.exter@jolla.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef NEMODEVICELOCK_PEERWRITER_H
+#define NEMODEVICELOCK_PEERWRITER_H
+
+#include <nemo-devicelock/host/latencyhistogram.h>
+
+#include <QDBusMessage>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QQueue>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+
+struct DBusConnection;
+struct DBusMessage;
+
+namespace NemoDeviceLock
+{
+
+// Writes messages to peer connections from a dedicated thread so a client which stops reading
+// its socket can't stall the main thread.  Messages are posted from the main thread and written
+// in the order they were posted.
+//
+// When the data buffered for a connection exceeds a high watermark the connection is congested
+// and messages which only report the current value of some properties are deferred.  A deferred
+// message is discarded if a later message reports all of its properties and the remainder are
+// sent in the order they were posted, ahead of anything posted since, once the buffered data
+// falls below a low watermark.  Replies and other signals are always written, a connection which
+// remains congested for longer than the eviction timeout is reported with connectionStalled() so
+// it can be disconnected.
+class PeerWriter : public QThread
+{
+    Q_OBJECT
+public:
+    enum {
+        MaximumQueuedMessages = 64,
+        HighWatermark = 64 * 1024,
+        LowWatermark = 16 * 1024,
+        EvictionTimeout = 10000,
+        CongestionPollInterval = 100
+    };
+
+    explicit PeerWriter(QObject *parent = nullptr);
+    ~PeerWriter();
+
+    bool post(
+            DBusConnection *connection,
+            const QString &connectionName,
+            DBusMessage *encodedMessage,
+            const QDBusMessage &message,
+            const QStringList &coalesceKeys = QStringList());
+
+    void discard(const QString &connectionName);
+
+    void stop();
+
+    QVariantMap statistics() const;
+
+signals:
+    void connectionStalled(const QString &connectionName);
+
+protected:
+    void run() override;
+
+private:
+    struct Message
+    {
+        DBusConnection *connection = nullptr;
+        DBusMessage *encodedMessage = nullptr;
+        QString connectionName;
+        QDBusMessage message;
+        QStringList coalesceKeys;
+        qint64 postTime = 0;
+    };
+
+    struct Peer
+    {
+        QList<Message> deferred;
+        qint64 congestedTime = 0;
+        int queued = 0;
+        bool congested = false;
+        bool stalled = false;
+    };
+
+    enum Disposition {
+        Write,
+        Defer
+    };
+
+    Disposition dispose(const Message &message);
+    void updateCongestion();
+    bool write(const Message &message);
+    static void release(const Message &message);
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_condition;
+    QQueue<Message> m_queue;
+    QHash<QString, Peer> m_peers;
+    QElapsedTimer m_clock;
+    LatencyHistogram m_queueLatency;
+    LatencyHistogram m_writeLatency;
+    int m_congestedCount;
+    int m_writtenCount;
+    int m_supersededCount;
+    int m_droppedCount;
+    int m_failedCount;
+    int m_stalledCount;
+    int m_peakQueued;
+    bool m_stopping;
+};
+
+}
+
+#endif
@@ -43,9 +43,15 @@ Connection *Connection::sharedInstance = nullptr;
 static QDBusConnection connectToHost()
 {
     static int counter = 0;
+    static const QString address = []() {
+        const QByteArray address = qgetenv("NEMODEVICELOCK_ADDRESS");
+        return !address.isEmpty()
+                ? QString::fromUtf8(address)
+                : QStringLiteral("unix:path=/run/nemo-devicelock/socket");
+    }();
 
     return QDBusConnection::connectToPeer(
-                QStringLiteral("unix:path=/run/nemo-devicelock/socket"),
+                address,
                 QStringLiteral("org.nemomobile.devicelock.%1").arg(counter++));
 }
 
@@ -101,6 +107,8 @@ ConnectionClient::ConnectionClient(
     : NemoDBus::Interface(context, *Connection::instance(), QString(), path, interface)
     , m_connection(Connection::instance())
     , m_localPath(localPath)
+    , m_path(path)
+    , m_interface(interface)
 {
 }
 
@@ -109,6 +117,28 @@ void ConnectionClient::registerObject()
     m_connection->registerObject(m_localPath.path(), context());
 }
 
+void ConnectionClient::subscribe()
+{
+    QDBusConnection connection = m_connection->connection();
+
+    if (m_subscribedConnection == connection.name()) {
+        return;
+    }
+
+    m_subscribedConnection = connection.name();
+
+    QDBusMessage message = QDBusMessage::createMethodCall(
+                QString(),
+                m_path,
+                QStringLiteral("org.nemomobile.devicelock.Subscription"),
+                QStringLiteral("Subscribe"));
+    message.setArguments({ m_interface });
+
+    if (!connection.send(message)) {
+        qCWarning(devicelock, "Failed to subscribe to %s", qPrintable(m_interface));
+    }
+}
+
 QDBusObjectPath ConnectionClient::generateLocalPath()
 {
     static const auto pid = QCoreApplication::applicationPid();
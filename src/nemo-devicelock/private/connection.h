@@ -69,11 +69,27 @@ protected:
 
     void registerObject();
 
+    // Registers interest in the signals of the interface with the host, once a connection has
+    // subscribed to an interface of an object the host only sends it the subscribed signals of
+    // that object.
+    void subscribe();
+
+    template <typename T, typename Handler> inline void subscribeToProperty(
+            const QString &property, const Handler &handler)
+    {
+        subscribe();
+        NemoDBus::Interface::subscribeToProperty<T>(property, handler);
+    }
+
     QExplicitlySharedDataPointer<Connection> m_connection;
     QDBusObjectPath m_localPath;
 
 private:
     static QDBusObjectPath generateLocalPath();
+
+    const QString m_path;
+    const QString m_interface;
+    QString m_subscribedConnection;
 };
 
 }
@@ -32,14 +32,22 @@
 
 #include "settingswatcher.h"
 
+#include <QCryptographicHash>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QEvent>
 #include <QFile>
 #include <QSettings>
 
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
 #include <glib.h>
 #include <sys/inotify.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "logging.h"
@@ -80,6 +88,156 @@ const char * const SettingsWatcher::isHomeEncryptedKey = "encrypt_home";
 
 SettingsWatcher *SettingsWatcher::sharedInstance = nullptr;
 
+// A single write of the settings file produces a burst of notifications, the file is reloaded
+// once this long after the first.
+static const int reloadDebounceInterval = 50;
+
+static const char * const snapshotDirectory = "/run/nemo-devicelock";
+static const char * const snapshotPath = "/run/nemo-devicelock/settings";
+static const char * const newSnapshotPath = "/run/nemo-devicelock/settings.new";
+
+static const SettingsFileStatus missingFile = { -1, 0, 0 };
+
+static const SettingsValues defaultSettings = {
+    0,                                      // automaticLocking
+    0,                                      // currentLength
+    5,                                      // minimumLength
+    42,                                     // maximumLength
+    -1,                                     // maximumAttempts
+    0,                                      // currentAttempts
+    1,                                      // peekingAllowed
+    -1,                                     // sideloadingAllowed
+    1,                                      // showNotifications
+    -1,                                     // maximumAutomaticLocking
+    -1,                                     // absoluteMaximumAttempts
+    DeviceReset::Reboot,                    // supportedDeviceResetOptions
+    AuthenticationInput::NoCodeGeneration,  // codeGeneration
+    false,                                  // inputIsKeyboard
+    true,                                   // currentCodeIsDigitOnly
+    false,                                  // isHomeEncrypted
+    false                                   // codeIsMandatory
+};
+
+enum SettingsType {
+    IntegerSetting,
+    BooleanSetting,
+    DeviceResetOptionsSetting,
+    CodeGenerationSetting
+};
+
+struct SettingsKey
+{
+    const char *name;
+    int length;
+    SettingsType type;
+    qint32 SettingsValues::*value;
+    bool writable;
+};
+
+#define SETTINGS_KEY(name, type, value, writable) { name, sizeof(name) - 1, type, &SettingsValues::value, writable }
+
+// All settings are in the desktop group and their keys share the nemo\devicelock\ prefix.  The
+// writable settings are those DeviceLockSettings can change.
+static const char settingsKeyPrefix[] = "nemo\\devicelock\\";
+
+static const SettingsKey settingsKeys[] = {
+    SETTINGS_KEY("automatic_locking", IntegerSetting, automaticLocking, true),
+    SETTINGS_KEY("code_current_length", IntegerSetting, currentLength, false),
+    SETTINGS_KEY("code_min_length", IntegerSetting, minimumLength, false),
+    SETTINGS_KEY("code_max_length", IntegerSetting, maximumLength, false),
+    SETTINGS_KEY("maximum_attempts", IntegerSetting, maximumAttempts, true),
+    SETTINGS_KEY("current_attempts", IntegerSetting, currentAttempts, false),
+    SETTINGS_KEY("peeking_allowed", IntegerSetting, peekingAllowed, true),
+    SETTINGS_KEY("sideloading_allowed", IntegerSetting, sideloadingAllowed, true),
+    SETTINGS_KEY("show_notification", IntegerSetting, showNotifications, true),
+    SETTINGS_KEY("code_input_is_keyboard", BooleanSetting, inputIsKeyboard, true),
+    SETTINGS_KEY("code_current_is_digit_only", BooleanSetting, currentCodeIsDigitOnly, false),
+    SETTINGS_KEY("encrypt_home", BooleanSetting, isHomeEncrypted, false),
+    SETTINGS_KEY("maximum_automatic_locking", IntegerSetting, maximumAutomaticLocking, false),
+    SETTINGS_KEY("absolute_maximum_attempts", IntegerSetting, absoluteMaximumAttempts, false),
+    SETTINGS_KEY("supported_device_reset_options", DeviceResetOptionsSetting, supportedDeviceResetOptions, false),
+    SETTINGS_KEY("code_is_mandatory", BooleanSetting, codeIsMandatory, false),
+    SETTINGS_KEY("code_generation", CodeGenerationSetting, codeGeneration, false)
+};
+
+#undef SETTINGS_KEY
+
+// The parsed settings published by the daemon for client processes to read instead of each
+// parsing the settings file.  The daemon writes each snapshot to a new file and renames it over
+// the previous one, so a reader never sees a partially written snapshot and readers watching the
+// directory are woken once for each snapshot published.  The status of the settings file the
+// values were loaded from is included so a reader can tell whether the snapshot is still current.
+struct SettingsSnapshot
+{
+    enum {
+        Magic = 0x534c444e,
+        Version = 3
+    };
+
+    quint32 magic;
+    quint32 version;
+    SettingsFileStatus file;
+    SettingsValues values;
+};
+
+static SettingsFileStatus fileStatus(const struct stat &status)
+{
+    return {
+        qint64(status.st_size),
+        qint64(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec,
+        quint64(status.st_ino)
+    };
+}
+
+static SettingsFileStatus fileStatus(const QString &path)
+{
+    struct stat status;
+    return stat(QFile::encodeName(path).constData(), &status) == 0
+            ? fileStatus(status)
+            : missingFile;
+}
+
+template <typename T>
+static void update(
+        SettingsWatcher *watcher,
+        T *member,
+        T value,
+        void (SettingsWatcher::*changed)() = nullptr)
+{
+    if (*member != value) {
+        *member = value;
+        if (changed) {
+            emit (watcher->*changed)();
+        }
+    }
+}
+
+SettingsState::SettingsState(const SettingsValues &values, quint64 generation)
+    : m_values(values)
+    , m_generation(generation)
+{
+}
+
+SettingsState::Fields SettingsState::changedFields(const SettingsState &previous) const
+{
+    return changedFields(previous.m_values, m_values);
+}
+
+SettingsState::Fields SettingsState::changedFields(
+        const SettingsValues &previous, const SettingsValues &current)
+{
+    const int count = sizeof(settingsKeys) / sizeof(settingsKeys[0]);
+    Q_STATIC_ASSERT(int(SettingsState::CodeGeneration) == 1 << (count - 1));
+
+    Fields fields;
+    for (int i = 0; i < count; ++i) {
+        if (previous.*settingsKeys[i].value != current.*settingsKeys[i].value) {
+            fields |= Field(1 << i);
+        }
+    }
+    return fields;
+}
+
 SettingsWatcher::SettingsWatcher(QObject *parent)
     : QSocketNotifier(inotify_init(), Read, parent)
     , automaticLocking(0)
@@ -100,26 +258,106 @@ SettingsWatcher::SettingsWatcher(QObject *parent)
     , isHomeEncrypted(false)
     , codeIsMandatory(false)
     , m_settingsPath(QStringLiteral("/usr/share/lipstick/devicelock/devicelock_settings.conf"))
+    , m_fileStatus(missingFile)
     , m_watch(-1)
+    , m_snapshotWatch(-1)
+    , m_performedReloadCount(0)
+    , m_suppressedReloadCount(0)
+    , m_debouncedEventCount(0)
+    , m_fastParseCount(0)
+    , m_fallbackParseCount(0)
+    , m_lastParseDuration(0)
+    , m_publishedModified(0)
+    , m_snapshotPublisher(false)
+    , m_snapshotRead(false)
+    , m_state(nullptr)
+    , m_stateReaders(0)
 {
     Q_ASSERT(!sharedInstance);
     sharedInstance = this;
 
-    m_watch = inotify_add_watch(
-                socket(),
-                "/usr/share/lipstick/devicelock",
-                IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM | IN_CLOSE_WRITE | IN_DELETE);
+    const auto state = new SettingsState(defaultSettings, 0);
+    state->ref.ref();
+    m_state.store(state);
+
+    m_reloadTimer.setSingleShot(true);
+    m_reloadTimer.setInterval(reloadDebounceInterval);
+
+    connect(&m_reloadTimer, &QTimer::timeout, this, &SettingsWatcher::settingsFileChanged);
+
+    // If the daemon has published a snapshot of the current settings use that instead of parsing
+    // the settings file, which is then only watched if the daemon stops publishing snapshots.
+    watchSnapshot();
 
-    reloadSettings();
+    if (!readSnapshot()) {
+        watchSettingsFile();
+        reloadIfChanged();
+    }
 }
 
 SettingsWatcher::~SettingsWatcher()
 {
+    // Without the daemon to publish changes clients have to watch the settings file themselves.
+    if (m_snapshotPublisher) {
+        unlink(snapshotPath);
+    }
+
     close(socket());
 
+    m_retiredStates.append(m_state.load());
+    for (const auto state : m_retiredStates) {
+        if (!state->ref.deref()) {
+            delete state;
+        }
+    }
+
     sharedInstance = nullptr;
 }
 
+// Returns the current settings, this can be called from any thread.  The fields of the watcher
+// itself are only updated and safe to read on the thread it lives in.
+QExplicitlySharedDataPointer<const SettingsState> SettingsWatcher::state() const
+{
+    ++m_stateReaders;
+    const QExplicitlySharedDataPointer<const SettingsState> state(m_state.load());
+    --m_stateReaders;
+
+    return state;
+}
+
+// Replaces the current state if any values have changed.  The replaced state is released once
+// no reader can be between loading it and acquiring a reference to it.
+void SettingsWatcher::publishState(const SettingsValues &values)
+{
+    const SettingsState * const previous = m_state.load();
+
+    if (!SettingsState::changedFields(previous->values(), values)) {
+        return;
+    }
+
+    const auto state = new SettingsState(values, previous->generation() + 1);
+    state->ref.ref();
+    m_state.store(state);
+
+    m_retiredStates.append(previous);
+
+    releaseRetiredStates();
+}
+
+void SettingsWatcher::releaseRetiredStates()
+{
+    if (m_stateReaders.load() != 0) {
+        return;
+    }
+
+    for (const auto state : m_retiredStates) {
+        if (!state->ref.deref()) {
+            delete state;
+        }
+    }
+    m_retiredStates.clear();
+}
+
 SettingsWatcher *SettingsWatcher::instance()
 {
     if (sharedInstance)
@@ -146,7 +384,15 @@ bool SettingsWatcher::event(QEvent *event)
             if (pevent->wd == m_watch
                     && pevent->len > 0
                     && QLatin1String(pevent->name) == QLatin1String("devicelock_settings.conf")) {
-                reloadSettings();
+                if (m_reloadTimer.isActive()) {
+                    ++m_debouncedEventCount;
+                } else {
+                    m_reloadTimer.start();
+                }
+            } else if (pevent->wd == m_snapshotWatch
+                    && pevent->len > 0
+                    && QLatin1String(pevent->name) == QLatin1String("settings")) {
+                snapshotChanged();
             }
         }
 
@@ -156,6 +402,268 @@ bool SettingsWatcher::event(QEvent *event)
     }
 }
 
+// Makes this process the publisher of the settings snapshot, the daemon does this so clients
+// can read the settings it has parsed.
+void SettingsWatcher::publishSnapshot()
+{
+    if (m_snapshotPublisher) {
+        return;
+    }
+
+    m_snapshotPublisher = true;
+
+    if (m_snapshotWatch != -1) {
+        inotify_rm_watch(socket(), m_snapshotWatch);
+        m_snapshotWatch = -1;
+    }
+
+    if (m_watch == -1) {
+        watchSettingsFile();
+    }
+
+    // A snapshot published by a previous instance may be out of date so the settings file is
+    // parsed before publishing unless the current values were parsed from it here.
+    if (m_performedReloadCount > 0 && !m_snapshotRead) {
+        writeSnapshot(m_fileStatus);
+    } else {
+        m_contentHash.clear();
+        reloadIfChanged();
+    }
+}
+
+void SettingsWatcher::watchSettingsFile()
+{
+    m_watch = inotify_add_watch(
+                socket(),
+                "/usr/share/lipstick/devicelock",
+                IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM | IN_CLOSE_WRITE | IN_DELETE);
+}
+
+void SettingsWatcher::unwatchSettingsFile()
+{
+    inotify_rm_watch(socket(), m_watch);
+    m_watch = -1;
+}
+
+// Only a published snapshot is renamed into place, the new file it's written to first is
+// ignored.
+void SettingsWatcher::watchSnapshot()
+{
+    m_snapshotWatch = inotify_add_watch(socket(), snapshotDirectory, IN_MOVED_TO | IN_DELETE);
+}
+
+// A client which reads a snapshot of the settings file as it is now stops watching the file,
+// and watches and parses it again if the snapshot is removed or doesn't describe the file.
+void SettingsWatcher::snapshotChanged()
+{
+    if (readSnapshot()) {
+        if (m_watch != -1) {
+            unwatchSettingsFile();
+        }
+        m_reloadTimer.stop();
+    } else if (m_watch == -1) {
+        watchSettingsFile();
+        reloadIfChanged();
+    }
+}
+
+// The snapshot directory may not have existed when a client started watching, if the daemon has
+// since published a snapshot the client can stop watching the settings file.
+void SettingsWatcher::settingsFileChanged()
+{
+    if (!m_snapshotPublisher && m_snapshotWatch == -1) {
+        watchSnapshot();
+
+        if (m_snapshotWatch != -1 && readSnapshot()) {
+            unwatchSettingsFile();
+            return;
+        }
+    }
+
+    reloadIfChanged();
+}
+
+int SettingsWatcher::performedReloadCount() const
+{
+    return m_performedReloadCount;
+}
+
+int SettingsWatcher::suppressedReloadCount() const
+{
+    return m_suppressedReloadCount;
+}
+
+int SettingsWatcher::debouncedEventCount() const
+{
+    return m_debouncedEventCount;
+}
+
+// The number of reloads handled by the single pass parser and the number which fell back to
+// GKeyFile.
+int SettingsWatcher::fastParseCount() const
+{
+    return m_fastParseCount;
+}
+
+int SettingsWatcher::fallbackParseCount() const
+{
+    return m_fallbackParseCount;
+}
+
+// The time in nanoseconds taken to parse the settings file on the most recent reload.
+qint64 SettingsWatcher::lastParseDuration() const
+{
+    return m_lastParseDuration;
+}
+
+// Reloads the settings file unless its size, modification time and content are the same as
+// when it was last loaded.  A missing file is loaded as an empty file.
+void SettingsWatcher::reloadIfChanged()
+{
+    SettingsFileStatus status = missingFile;
+    QByteArray data;
+
+    // The file is read into a buffer rather than mapped, the plugin may rewrite or truncate it
+    // at any time and accessing a mapping of a truncated file would fault.  The buffer is then
+    // parsed in place.
+    QFile file(m_settingsPath);
+    if (file.open(QIODevice::ReadOnly)) {
+        struct stat fileStat;
+        if (fstat(file.handle(), &fileStat) == 0) {
+            status = fileStatus(fileStat);
+        }
+
+        data = file.readAll();
+    }
+
+    const QByteArray contentHash = QCryptographicHash::hash(data, QCryptographicHash::Md5);
+
+    if (m_performedReloadCount > 0
+            && status == m_fileStatus
+            && contentHash == m_contentHash) {
+        ++m_suppressedReloadCount;
+        return;
+    }
+
+    m_fileStatus = status;
+    m_contentHash = contentHash;
+
+    const bool initial = m_performedReloadCount == 0;
+    const quint64 generation = m_state.load()->generation();
+
+    ++m_performedReloadCount;
+
+    reloadSettings(data.constData(), data.size());
+
+    // The snapshot is written even if the values were already applied when they were written so
+    // clients know it's current for the file as it is now.  A client which read a snapshot before
+    // parsing the file for the first time has to be notified of any changes.
+    const bool changed = m_state.load()->generation() != generation;
+
+    m_publishedModified = m_fileStatus.modified;
+
+    if (m_snapshotPublisher) {
+        writeSnapshot(m_fileStatus);
+    }
+
+    if (!initial) {
+        emit reloaded();
+    }
+
+    if (changed && (!initial || m_snapshotRead)) {
+        emit stateChanged();
+    }
+}
+
+// Reads the settings published by the daemon.  Returns false if there is no snapshot of the
+// settings file as it is now, because the daemon isn't running or hasn't yet reloaded a changed
+// file, in which case the file should be parsed.
+bool SettingsWatcher::readSnapshot()
+{
+    const int fd = open(snapshotPath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    SettingsSnapshot snapshot;
+    const ssize_t size = read(fd, &snapshot, sizeof(snapshot));
+
+    close(fd);
+
+    if (size != ssize_t(sizeof(snapshot))
+            || snapshot.magic != SettingsSnapshot::Magic
+            || snapshot.version != SettingsSnapshot::Version
+            || snapshot.file != fileStatus(m_settingsPath)) {
+        return false;
+    }
+
+    m_snapshotRead = true;
+
+    const quint64 generation = m_state.load()->generation();
+
+    applySettings(snapshot.values);
+
+    if (m_state.load()->generation() != generation) {
+        emit reloaded();
+        emit stateChanged();
+    }
+
+    return true;
+}
+
+void SettingsWatcher::applySettings(const SettingsValues &values)
+{
+    // Publish the new state before notifying of any changes so it's consistent with the fields.
+    publishState(values);
+
+    update(this, &automaticLocking, int(values.automaticLocking), &SettingsWatcher::automaticLockingChanged);
+    update(this, &currentLength, int(values.currentLength), &SettingsWatcher::currentLengthChanged);
+    update(this, &minimumLength, int(values.minimumLength), &SettingsWatcher::minimumLengthChanged);
+    update(this, &maximumLength, int(values.maximumLength), &SettingsWatcher::maximumLengthChanged);
+    update(this, &maximumAttempts, int(values.maximumAttempts), &SettingsWatcher::maximumAttemptsChanged);
+    update(this, &currentAttempts, int(values.currentAttempts), &SettingsWatcher::currentAttemptsChanged);
+    update(this, &peekingAllowed, int(values.peekingAllowed), &SettingsWatcher::peekingAllowedChanged);
+    update(this, &sideloadingAllowed, int(values.sideloadingAllowed), &SettingsWatcher::sideloadingAllowedChanged);
+    update(this, &showNotifications, int(values.showNotifications), &SettingsWatcher::showNotificationsChanged);
+    update(this, &inputIsKeyboard, bool(values.inputIsKeyboard), &SettingsWatcher::inputIsKeyboardChanged);
+    update(this, &currentCodeIsDigitOnly, bool(values.currentCodeIsDigitOnly), &SettingsWatcher::currentCodeIsDigitOnlyChanged);
+    update(this, &isHomeEncrypted, bool(values.isHomeEncrypted));
+
+    update(this, &maximumAutomaticLocking, int(values.maximumAutomaticLocking), &SettingsWatcher::maximumAutomaticLockingChanged);
+    update(this, &absoluteMaximumAttempts, int(values.absoluteMaximumAttempts), &SettingsWatcher::absoluteMaximumAttemptsChanged);
+    update(this, &supportedDeviceResetOptions, DeviceReset::Options(values.supportedDeviceResetOptions), &SettingsWatcher::supportedDeviceResetOptionsChanged);
+    update(this, &codeIsMandatory, bool(values.codeIsMandatory), &SettingsWatcher::codeIsMandatoryChanged);
+    update(this, &codeGeneration, AuthenticationInput::CodeGeneration(values.codeGeneration), &SettingsWatcher::codeGenerationChanged);
+}
+
+// The snapshot records the status of the settings file the values were loaded from, or for
+// written settings the file they were written to.
+void SettingsWatcher::writeSnapshot(const SettingsFileStatus &file)
+{
+    SettingsSnapshot snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+
+    snapshot.magic = SettingsSnapshot::Magic;
+    snapshot.version = SettingsSnapshot::Version;
+    snapshot.file = file;
+    snapshot.values = m_state.load()->values();
+
+    const int fd = open(newSnapshotPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        qCWarning(devicelock, "Failed to create the settings snapshot %s", newSnapshotPath);
+        return;
+    }
+
+    const bool written = write(fd, &snapshot, sizeof(snapshot)) == ssize_t(sizeof(snapshot));
+
+    close(fd);
+
+    if (!written || rename(newSnapshotPath, snapshotPath) != 0) {
+        qCWarning(devicelock, "Failed to publish the settings snapshot %s", snapshotPath);
+        unlink(newSnapshotPath);
+    }
+}
+
 template <typename T> T readConfigValue(GKeyFile *config, const char *group, const char *key, T defaultValue)
 {
     GError *error = nullptr;
@@ -212,69 +720,310 @@ template <> bool readConfigValue<bool>(
     }
 }
 
-template <typename T>
-static void read(
-        GKeyFile *settings,
-        SettingsWatcher *watcher,
-        const char *group,
-        const char *key,
-        T defaultValue,
-        T *member,
-        void (SettingsWatcher::*changed)() = nullptr)
+static void readConfigValues(GKeyFile *config, SettingsValues *values)
 {
-    const T value = readConfigValue<T>(settings, group, key, defaultValue);
+    for (const SettingsKey &key : settingsKeys) {
+        const QByteArray name = settingsKeyPrefix + QByteArray(key.name, key.length);
+        qint32 &value = values->*key.value;
 
-    if (*member != value) {
-        *member = value;
-        if (changed) {
-            emit (watcher->*changed)();
+        switch (key.type) {
+        case IntegerSetting:
+            value = readConfigValue<int>(config, "desktop", name.constData(), value);
+            break;
+        case BooleanSetting:
+            value = readConfigValue<bool>(config, "desktop", name.constData(), value);
+            break;
+        case DeviceResetOptionsSetting:
+            value = int(readConfigValue<DeviceReset::Options>(
+                        config, "desktop", name.constData(), DeviceReset::Options(value)));
+            break;
+        case CodeGenerationSetting:
+            value = readConfigValue<AuthenticationInput::CodeGeneration>(
+                        config, "desktop", name.constData(), AuthenticationInput::CodeGeneration(value));
+            break;
         }
     }
 }
 
-template <typename T>
-static void read(
-        GKeyFile *settings,
-        SettingsWatcher *watcher,
-        const char *key,
-        T defaultValue,
-        T *member,
-        void (SettingsWatcher::*changed)() = nullptr)
+static inline bool isSpace(char character)
+{
+    return character == ' ' || character == '\t' || character == '\r'
+            || character == '\f' || character == '\v';
+}
+
+static const char *skipSpace(const char *begin, const char *end)
+{
+    while (begin != end && isSpace(*begin)) {
+        ++begin;
+    }
+    return begin;
+}
+
+static const char *chopSpace(const char *begin, const char *end)
+{
+    while (end != begin && isSpace(end[-1])) {
+        --end;
+    }
+    return end;
+}
+
+static bool parseInteger(const char *begin, const char *end, qint32 *value)
+{
+    const bool negative = begin != end && *begin == '-';
+    if (begin != end && (*begin == '-' || *begin == '+')) {
+        ++begin;
+    }
+
+    if (begin == end) {
+        return false;
+    }
+
+    qint64 result = 0;
+    for (; begin != end; ++begin) {
+        if (*begin < '0' || *begin > '9') {
+            return false;
+        }
+        result = (result * 10) + (*begin - '0');
+        if (result > qint64(INT_MAX) + 1) {
+            return false;
+        }
+    }
+
+    if (negative) {
+        result = -result;
+    } else if (result > INT_MAX) {
+        return false;
+    }
+
+    *value = qint32(result);
+
+    return true;
+}
+
+static bool parseBoolean(const char *begin, const char *end, qint32 *value)
+{
+    const int length = end - begin;
+
+    if ((length == 4 && memcmp(begin, "true", 4) == 0) || (length == 1 && *begin == '1')) {
+        *value = true;
+        return true;
+    } else if ((length == 5 && memcmp(begin, "false", 5) == 0) || (length == 1 && *begin == '0')) {
+        *value = false;
+        return true;
+    } else {
+        return false;
+    }
+}
+
+// Equivalent to flagsFromString() without splitting the value into a list.
+static bool parseFlags(const QMetaEnum &enumeration, const char *begin, const char *end, qint32 *value)
+{
+    char key[64];
+    int flags = 0;
+
+    for (;;) {
+        const char *separator = static_cast<const char *>(memchr(begin, ',', end - begin));
+        if (!separator) {
+            separator = end;
+        }
+
+        const int length = separator - begin;
+        if (length >= int(sizeof(key))) {
+            return false;
+        }
+
+        memcpy(key, begin, length);
+        key[length] = '\0';
+
+        const int flag = enumeration.keyToValue(key);
+        if (flag != -1) {
+            flags |= flag;
+        }
+
+        if (separator == end) {
+            break;
+        }
+        begin = separator + 1;
+    }
+
+    *value = flags;
+
+    return true;
+}
+
+static bool parseValue(SettingsType type, const char *begin, const char *end, qint32 *value)
+{
+    // Leave escape sequences and anything other than ASCII to GKeyFile.
+    for (const char *character = begin; character != end; ++character) {
+        if (*character == '\\' || static_cast<unsigned char>(*character) >= 0x80) {
+            return false;
+        }
+    }
+
+    switch (type) {
+    case IntegerSetting:
+        return parseInteger(begin, end, value);
+    case BooleanSetting:
+        return parseBoolean(begin, end, value);
+    case DeviceResetOptionsSetting:
+        return parseFlags(resolveMetaEnum<DeviceReset::Option>(), begin, end, value);
+    case CodeGenerationSetting:
+        return parseFlags(resolveMetaEnum<AuthenticationInput::CodeGeneration>(), begin, end, value);
+    }
+
+    return false;
+}
+
+// Reads the settings in a single pass over the file contents without allocating.  Only the
+// subset of the key file syntax written by the settings implementations is understood, if
+// anything else is encountered false is returned and the file should be parsed with GKeyFile
+// instead.
+bool parseSettings(const char *data, int size, SettingsValues *values)
 {
-    read(settings,
-                watcher,
-                "desktop",
-                (QByteArrayLiteral("nemo\\devicelock\\") + key).constData(),
-                defaultValue,
-                member,
-                changed);
+    const char * const end = data + size;
+    const int prefixLength = sizeof(settingsKeyPrefix) - 1;
+
+    bool inGroup = false;
+    bool inDesktopGroup = false;
+
+    for (const char *line = data; line != end;) {
+        const char *lineEnd = static_cast<const char *>(memchr(line, '\n', end - line));
+        const char * const next = lineEnd ? lineEnd + 1 : end;
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+
+        line = skipSpace(line, lineEnd);
+        lineEnd = chopSpace(line, lineEnd);
+
+        if (line == lineEnd || *line == '#') {
+            // Blank line or comment.
+        } else if (*line == '[') {
+            if (lineEnd[-1] != ']') {
+                return false;
+            }
+
+            inGroup = true;
+            inDesktopGroup = lineEnd - line == 9 && memcmp(line + 1, "desktop", 7) == 0;
+        } else {
+            const char * const equals = static_cast<const char *>(memchr(line, '=', lineEnd - line));
+            if (!equals || !inGroup) {
+                return false;
+            }
+
+            const char * const keyEnd = chopSpace(line, equals);
+
+            if (inDesktopGroup
+                    && keyEnd - line > prefixLength
+                    && memcmp(line, settingsKeyPrefix, prefixLength) == 0) {
+                const char * const name = line + prefixLength;
+                const int length = keyEnd - name;
+
+                for (const SettingsKey &key : settingsKeys) {
+                    if (key.length == length && memcmp(key.name, name, length) == 0) {
+                        if (!parseValue(key.type, skipSpace(equals + 1, lineEnd), lineEnd, &(values->*key.value))) {
+                            return false;
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+
+        line = next;
+    }
+
+    return true;
 }
 
-void SettingsWatcher::reloadSettings()
+void parseSettingsWithKeyFile(const char *data, int size, SettingsValues *values)
 {
     GKeyFile * const settings = g_key_file_new();
-    g_key_file_load_from_file(settings, m_settingsPath.toUtf8().constData(), G_KEY_FILE_NONE, 0);
-
-    read(settings, this, automaticLockingKey, 0, &automaticLocking, &SettingsWatcher::automaticLockingChanged);
-    read(settings, this, currentLengthKey, 0, &currentLength, &SettingsWatcher::currentLengthChanged);
-    read(settings, this, minimumLengthKey, 5, &minimumLength, &SettingsWatcher::minimumLengthChanged);
-    read(settings, this, maximumLengthKey, 42, &maximumLength, &SettingsWatcher::maximumLengthChanged);
-    read(settings, this, maximumAttemptsKey, -1, &maximumAttempts, &SettingsWatcher::maximumAttemptsChanged);
-    read(settings, this, currentAttemptsKey, 0, &currentAttempts, &SettingsWatcher::currentAttemptsChanged);
-    read(settings, this, peekingAllowedKey, 1, &peekingAllowed, &SettingsWatcher::peekingAllowedChanged);
-    read(settings, this, sideloadingAllowedKey, -1, &sideloadingAllowed, &SettingsWatcher::sideloadingAllowedChanged);
-    read(settings, this, showNotificationsKey, 1, &showNotifications, &SettingsWatcher::showNotificationsChanged);
-    read(settings, this, inputIsKeyboardKey, false, &inputIsKeyboard, &SettingsWatcher::inputIsKeyboardChanged);
-    read(settings, this, currentIsDigitOnlyKey, true, &currentCodeIsDigitOnly, &SettingsWatcher::currentCodeIsDigitOnlyChanged);
-    read(settings, this, isHomeEncryptedKey, false, &isHomeEncrypted);
-
-    read(settings, this, "maximum_automatic_locking", -1, &maximumAutomaticLocking, &SettingsWatcher::maximumAutomaticLockingChanged);
-    read(settings, this, "absolute_maximum_attempts", -1, &absoluteMaximumAttempts, &SettingsWatcher::absoluteMaximumAttemptsChanged);
-    read(settings, this, "supported_device_reset_options", DeviceReset::Options(DeviceReset::Reboot), &supportedDeviceResetOptions, &SettingsWatcher::supportedDeviceResetOptionsChanged);
-    read(settings, this, "code_is_mandatory", false, &codeIsMandatory, &SettingsWatcher::codeIsMandatoryChanged);
-    read(settings, this, "code_generation", AuthenticationInput::NoCodeGeneration, &codeGeneration, &SettingsWatcher::codeGenerationChanged);
+    g_key_file_load_from_data(settings, data, size, G_KEY_FILE_NONE, 0);
+
+    readConfigValues(settings, values);
 
     g_key_file_free(settings);
 }
 
+void SettingsWatcher::reloadSettings(const char *data, int size)
+{
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    SettingsValues values = defaultSettings;
+
+    if (parseSettings(data, size, &values)) {
+        ++m_fastParseCount;
+    } else {
+        ++m_fallbackParseCount;
+
+        values = defaultSettings;
+
+        parseSettingsWithKeyFile(data, size, &values);
+    }
+
+    m_lastParseDuration = elapsed.nsecsElapsed();
+
+    applySettings(values);
+}
+
+// Applies settings which have been successfully written to the settings file without waiting
+// for the file to be reloaded.  Only the settings DeviceLockSettings can change are applied and
+// only if the file has changed since it was last loaded, if it has already been reloaded the
+// values read from it stand.  When the file is reloaded its values replace any applied here and
+// if they're the same nothing further is published.  Keys may be given with or without the
+// /desktop/nemo/devicelock/ path.  Returns true if any values were published.
+bool SettingsWatcher::applyWrittenSettings(const QStringList &keysAndValues)
+{
+    const SettingsFileStatus status = fileStatus(m_settingsPath);
+    if (status == m_fileStatus) {
+        return false;
+    }
+
+    SettingsValues values = m_state.load()->values();
+
+    for (int i = 0; i + 1 < keysAndValues.count(); i += 2) {
+        const QString &path = keysAndValues.at(i);
+        const QByteArray name = path.mid(path.lastIndexOf(QLatin1Char('/')) + 1).toUtf8();
+        const QByteArray value = keysAndValues.at(i + 1).toUtf8();
+
+        for (const SettingsKey &key : settingsKeys) {
+            if (key.length == name.length() && memcmp(key.name, name.constData(), key.length) == 0) {
+                // Other settings and values which can't be parsed here are left for the reload
+                // to apply.
+                if (key.writable) {
+                    parseValue(key.type, value.constData(), value.constData() + value.length(), &(values.*key.value));
+                }
+                break;
+            }
+        }
+    }
+
+    const quint64 generation = m_state.load()->generation();
+
+    applySettings(values);
+
+    if (m_state.load()->generation() == generation) {
+        return false;
+    }
+
+    m_publishedModified = status.modified;
+
+    if (m_snapshotPublisher) {
+        writeSnapshot(status);
+    }
+
+    emit stateChanged();
+
+    return true;
+}
+
+// The modification time in nanoseconds since the epoch of the settings file the most recently
+// published values were loaded from or written to.
+qint64 SettingsWatcher::publishedModified() const
+{
+    return m_publishedModified;
+}
+
 }
@@ -36,9 +36,14 @@
 #include <nemo-devicelock/authenticationinput.h>
 #include <nemo-devicelock/devicereset.h>
 
+#include <QDateTime>
 #include <QMetaEnum>
 #include <QSharedData>
 #include <QSocketNotifier>
+#include <QTimer>
+#include <QVector>
+
+#include <atomic>
 
 namespace NemoDeviceLock
 {
@@ -62,6 +67,103 @@ template <> inline QMetaEnum resolveMetaEnum<AuthenticationInput::CodeGeneration
 template <> inline AuthenticationInput::CodeGeneration settingsValueFromString<AuthenticationInput::CodeGeneration>(const char *string) {
     return AuthenticationInput::CodeGeneration(flagsFromString(resolveMetaEnum<AuthenticationInput::CodeGeneration>(), string)); }
 
+// Identifies a version of the settings file, a missing file has a size of -1.
+struct SettingsFileStatus
+{
+    qint64 size;
+    qint64 modified;
+    quint64 inode;
+
+    bool operator ==(const SettingsFileStatus &other) const {
+        return size == other.size && modified == other.modified && inode == other.inode; }
+    bool operator !=(const SettingsFileStatus &other) const { return !(*this == other); }
+};
+
+struct SettingsValues
+{
+    qint32 automaticLocking;
+    qint32 currentLength;
+    qint32 minimumLength;
+    qint32 maximumLength;
+    qint32 maximumAttempts;
+    qint32 currentAttempts;
+    qint32 peekingAllowed;
+    qint32 sideloadingAllowed;
+    qint32 showNotifications;
+    qint32 maximumAutomaticLocking;
+    qint32 absoluteMaximumAttempts;
+    qint32 supportedDeviceResetOptions;
+    qint32 codeGeneration;
+    qint32 inputIsKeyboard;
+    qint32 currentCodeIsDigitOnly;
+    qint32 isHomeEncrypted;
+    qint32 codeIsMandatory;
+};
+
+// Parse the contents of the settings file into values, the first with the single pass parser
+// the watcher tries first and the second with GKeyFile which it falls back to.
+bool NEMODEVICELOCK_EXPORT parseSettings(const char *data, int size, SettingsValues *values);
+void NEMODEVICELOCK_EXPORT parseSettingsWithKeyFile(const char *data, int size, SettingsValues *values);
+
+// An immutable set of settings values which can be held and read from any thread.
+class NEMODEVICELOCK_EXPORT SettingsState : public QSharedData
+{
+public:
+    // In the order of the keys in the settings file.
+    enum Field {
+        AutomaticLocking            = 0x00001,
+        CurrentLength               = 0x00002,
+        MinimumLength               = 0x00004,
+        MaximumLength               = 0x00008,
+        MaximumAttempts             = 0x00010,
+        CurrentAttempts             = 0x00020,
+        PeekingAllowed              = 0x00040,
+        SideloadingAllowed          = 0x00080,
+        ShowNotifications           = 0x00100,
+        InputIsKeyboard             = 0x00200,
+        CurrentCodeIsDigitOnly      = 0x00400,
+        IsHomeEncrypted             = 0x00800,
+        MaximumAutomaticLocking     = 0x01000,
+        AbsoluteMaximumAttempts     = 0x02000,
+        SupportedDeviceResetOptions = 0x04000,
+        CodeIsMandatory             = 0x08000,
+        CodeGeneration              = 0x10000
+    };
+    Q_DECLARE_FLAGS(Fields, Field)
+
+    SettingsState(const SettingsValues &values, quint64 generation);
+
+    quint64 generation() const { return m_generation; }
+    const SettingsValues &values() const { return m_values; }
+
+    int automaticLocking() const { return m_values.automaticLocking; }
+    int currentLength() const { return m_values.currentLength; }
+    int minimumLength() const { return m_values.minimumLength; }
+    int maximumLength() const { return m_values.maximumLength; }
+    int maximumAttempts() const { return m_values.maximumAttempts; }
+    int currentAttempts() const { return m_values.currentAttempts; }
+    int peekingAllowed() const { return m_values.peekingAllowed; }
+    int sideloadingAllowed() const { return m_values.sideloadingAllowed; }
+    int showNotifications() const { return m_values.showNotifications; }
+    int maximumAutomaticLocking() const { return m_values.maximumAutomaticLocking; }
+    int absoluteMaximumAttempts() const { return m_values.absoluteMaximumAttempts; }
+    DeviceReset::Options supportedDeviceResetOptions() const {
+        return DeviceReset::Options(m_values.supportedDeviceResetOptions); }
+    AuthenticationInput::CodeGeneration codeGeneration() const {
+        return AuthenticationInput::CodeGeneration(m_values.codeGeneration); }
+    bool inputIsKeyboard() const { return m_values.inputIsKeyboard; }
+    bool currentCodeIsDigitOnly() const { return m_values.currentCodeIsDigitOnly; }
+    bool isHomeEncrypted() const { return m_values.isHomeEncrypted; }
+    bool codeIsMandatory() const { return m_values.codeIsMandatory; }
+
+    Fields changedFields(const SettingsState &previous) const;
+    static Fields changedFields(const SettingsValues &previous, const SettingsValues &current);
+
+private:
+    const SettingsValues m_values;
+    const quint64 m_generation;
+};
+
 class NEMODEVICELOCK_EXPORT SettingsWatcher : public QSocketNotifier, public QSharedData
 {
     Q_OBJECT
@@ -103,6 +205,20 @@ public:
 
     bool event(QEvent *event);
 
+    QExplicitlySharedDataPointer<const SettingsState> state() const;
+
+    bool applyWrittenSettings(const QStringList &keysAndValues);
+    qint64 publishedModified() const;
+
+    void publishSnapshot();
+
+    int performedReloadCount() const;
+    int suppressedReloadCount() const;
+    int debouncedEventCount() const;
+    int fastParseCount() const;
+    int fallbackParseCount() const;
+    qint64 lastParseDuration() const;
+
 signals:
     void automaticLockingChanged();
     void maximumAttemptsChanged();
@@ -120,18 +236,50 @@ signals:
     void currentCodeIsDigitOnlyChanged();
     void codeIsMandatoryChanged();
     void codeGenerationChanged();
+    void reloaded();
+    void stateChanged();
 
 private:
     explicit SettingsWatcher(QObject *parent = nullptr);
 
-    void reloadSettings();
+    void watchSettingsFile();
+    void unwatchSettingsFile();
+    void watchSnapshot();
+    void snapshotChanged();
+    void settingsFileChanged();
+    void reloadIfChanged();
+    void reloadSettings(const char *data, int size);
+    void applySettings(const SettingsValues &values);
+    void publishState(const SettingsValues &values);
+    void releaseRetiredStates();
+    bool readSnapshot();
+    void writeSnapshot(const SettingsFileStatus &file);
 
     QString m_settingsPath;
+    QTimer m_reloadTimer;
+    SettingsFileStatus m_fileStatus;
+    QByteArray m_contentHash;
     int m_watch;
+    int m_snapshotWatch;
+    int m_performedReloadCount;
+    int m_suppressedReloadCount;
+    int m_debouncedEventCount;
+    int m_fastParseCount;
+    int m_fallbackParseCount;
+    qint64 m_lastParseDuration;
+    qint64 m_publishedModified;
+    bool m_snapshotPublisher;
+    bool m_snapshotRead;
+
+    std::atomic<const SettingsState *> m_state;
+    mutable std::atomic<int> m_stateReaders;
+    QVector<const SettingsState *> m_retiredStates;
 
     static SettingsWatcher *sharedInstance;
 };
 
 }
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(NemoDeviceLock::SettingsState::Fields)
+
 #endif